@@ -0,0 +1,426 @@
+/**
+ * Forward mode automatic differentiation with dual numbers.
+ *
+ * A Dual<T, M> carries a value together with its derivatives along M seed
+ * directions. Every arithmetic operation and elementary function applies the
+ * chain rule to the derivatives as well as the value, so a function written
+ * as a template over its number type and evaluated on duals returns exact
+ * derivatives (to rounding), with no hand written derivative and none of the
+ * truncation error or step size choice of finite differences.
+ *
+ * Seeding input i with direction i gives a whole N by N Jacobian from a single
+ * evaluation with M = N. The M derivatives are held in a fixed length array and
+ * updated together in short loops, which the compiler unrolls or vectorises.
+ *
+ * Elementary functions (sin, exp, ...) should be called unqualified inside
+ * templated functions, after a using declaration for the std version, so the
+ * double and dual overloads are both found:
+ *
+ * 	template <typename T> T f(T x) { using std::sin; return x * sin(x); }
+ *
+ * Shared between the worksheets: Newton-Raphson in worksheet1 and the ODE
+ * Jacobians in worksheet3.
+ */
+
+#ifndef DUAL_H
+#define DUAL_H
+
+#include <cstddef>
+#include <cmath>
+
+/**
+ * Value and derivatives along M seed directions.
+ */
+template <typename T = double, std::size_t M = 1>
+struct Dual
+{
+	typedef T value_type;
+	static const std::size_t seeds = M;
+
+	T value;
+	T d[M];
+
+	// Zero.
+	Dual() :
+		value(0)
+	{
+		for (std::size_t i = 0; i != M; i++)
+			d[i] = 0;
+	}
+
+	// A constant, so with zero derivatives. Not explicit, so that constants
+	// mix freely with duals in expressions.
+	Dual(T value) :
+		value(value)
+	{
+		for (std::size_t i = 0; i != M; i++)
+			d[i] = 0;
+	}
+
+	// An independent variable, with unit derivative along seed direction.
+	Dual(T value, std::size_t seed) :
+		value(value)
+	{
+		for (std::size_t i = 0; i != M; i++)
+			d[i] = 0;
+		d[seed] = 1;
+	}
+
+	Dual & operator+=(const Dual & rhs)
+	{
+		value += rhs.value;
+		for (std::size_t i = 0; i != M; i++)
+			d[i] += rhs.d[i];
+		return *this;
+	}
+
+	Dual & operator-=(const Dual & rhs)
+	{
+		value -= rhs.value;
+		for (std::size_t i = 0; i != M; i++)
+			d[i] -= rhs.d[i];
+		return *this;
+	}
+
+	Dual & operator*=(const Dual & rhs)
+	{
+		for (std::size_t i = 0; i != M; i++)
+			d[i] = d[i] * rhs.value + value * rhs.d[i];
+		value *= rhs.value;
+		return *this;
+	}
+
+	Dual & operator/=(const Dual & rhs)
+	{
+		T inverse = 1 / rhs.value;
+		value *= inverse;
+		for (std::size_t i = 0; i != M; i++)
+			d[i] = (d[i] - value * rhs.d[i]) * inverse;
+		return *this;
+	}
+
+	Dual & operator*=(T scalar)
+	{
+		value *= scalar;
+		for (std::size_t i = 0; i != M; i++)
+			d[i] *= scalar;
+		return *this;
+	}
+
+	Dual & operator/=(T scalar)
+	{
+		return *this *= 1 / scalar;
+	}
+};
+
+/**
+ * Result of a function g of one variable applied to a dual: the value g(x) and
+ * each derivative scaled by g'(x).
+ */
+template <typename T, std::size_t M>
+Dual<T, M> ChainRule(const Dual<T, M> & x, T value, T derivative)
+{
+	Dual<T, M> result(value);
+	for (std::size_t i = 0; i != M; i++)
+		result.d[i] = derivative * x.d[i];
+	return result;
+}
+
+// Scalar type of a dual, used so that the scalar in a mixed operation is not
+// deduced and ints or doubles convert to it.
+template <typename D>
+struct DualScalar
+{
+	typedef typename D::value_type type;
+};
+
+template <typename T, std::size_t M>
+Dual<T, M> operator+(Dual<T, M> lhs, const Dual<T, M> & rhs)
+{
+	return lhs += rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator+(Dual<T, M> lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	lhs.value += rhs;
+	return lhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator+(typename DualScalar<Dual<T, M> >::type lhs, Dual<T, M> rhs)
+{
+	rhs.value += lhs;
+	return rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator-(Dual<T, M> lhs, const Dual<T, M> & rhs)
+{
+	return lhs -= rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator-(Dual<T, M> lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	lhs.value -= rhs;
+	return lhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator-(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return Dual<T, M>(lhs) -= rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator-(Dual<T, M> x)
+{
+	x.value = -x.value;
+	for (std::size_t i = 0; i != M; i++)
+		x.d[i] = -x.d[i];
+	return x;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator*(Dual<T, M> lhs, const Dual<T, M> & rhs)
+{
+	return lhs *= rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator*(Dual<T, M> lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs *= rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator*(typename DualScalar<Dual<T, M> >::type lhs, Dual<T, M> rhs)
+{
+	return rhs *= lhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator/(Dual<T, M> lhs, const Dual<T, M> & rhs)
+{
+	return lhs /= rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator/(Dual<T, M> lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs /= rhs;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> operator/(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return Dual<T, M>(lhs) /= rhs;
+}
+
+// Comparisons look only at the value, so branches in user functions work.
+template <typename T, std::size_t M>
+bool operator<(const Dual<T, M> & lhs, const Dual<T, M> & rhs)
+{
+	return lhs.value < rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator>(const Dual<T, M> & lhs, const Dual<T, M> & rhs)
+{
+	return lhs.value > rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator<=(const Dual<T, M> & lhs, const Dual<T, M> & rhs)
+{
+	return lhs.value <= rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator>=(const Dual<T, M> & lhs, const Dual<T, M> & rhs)
+{
+	return lhs.value >= rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator==(const Dual<T, M> & lhs, const Dual<T, M> & rhs)
+{
+	return lhs.value == rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator!=(const Dual<T, M> & lhs, const Dual<T, M> & rhs)
+{
+	return lhs.value != rhs.value;
+}
+
+// Mixed comparisons with a scalar, as for the arithmetic operators, so that
+// e.g. x < 0 works without writing out the dual.
+template <typename T, std::size_t M>
+bool operator<(const Dual<T, M> & lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs.value < rhs;
+}
+
+template <typename T, std::size_t M>
+bool operator<(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return lhs < rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator>(const Dual<T, M> & lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs.value > rhs;
+}
+
+template <typename T, std::size_t M>
+bool operator>(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return lhs > rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator<=(const Dual<T, M> & lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs.value <= rhs;
+}
+
+template <typename T, std::size_t M>
+bool operator<=(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return lhs <= rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator>=(const Dual<T, M> & lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs.value >= rhs;
+}
+
+template <typename T, std::size_t M>
+bool operator>=(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return lhs >= rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator==(const Dual<T, M> & lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs.value == rhs;
+}
+
+template <typename T, std::size_t M>
+bool operator==(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return lhs == rhs.value;
+}
+
+template <typename T, std::size_t M>
+bool operator!=(const Dual<T, M> & lhs, typename DualScalar<Dual<T, M> >::type rhs)
+{
+	return lhs.value != rhs;
+}
+
+template <typename T, std::size_t M>
+bool operator!=(typename DualScalar<Dual<T, M> >::type lhs, const Dual<T, M> & rhs)
+{
+	return lhs != rhs.value;
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> sin(const Dual<T, M> & x)
+{
+	return ChainRule(x, std::sin(x.value), std::cos(x.value));
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> cos(const Dual<T, M> & x)
+{
+	return ChainRule(x, std::cos(x.value), -std::sin(x.value));
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> tan(const Dual<T, M> & x)
+{
+	T value = std::tan(x.value);
+	return ChainRule(x, value, 1 + value * value);
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> exp(const Dual<T, M> & x)
+{
+	T value = std::exp(x.value);
+	return ChainRule(x, value, value);
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> log(const Dual<T, M> & x)
+{
+	return ChainRule(x, std::log(x.value), 1 / x.value);
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> sqrt(const Dual<T, M> & x)
+{
+	T value = std::sqrt(x.value);
+	return ChainRule(x, value, 1 / (2 * value));
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> pow(const Dual<T, M> & x, typename DualScalar<Dual<T, M> >::type power)
+{
+	return ChainRule(x, std::pow(x.value, power), power * std::pow(x.value, power - 1));
+}
+
+template <typename T, std::size_t M>
+Dual<T, M> abs(const Dual<T, M> & x)
+{
+	return x.value < 0 ? -x : x;
+}
+
+/**
+ * Value of a number, for code that is templated over double and Dual.
+ */
+inline double Value(double x)
+{
+	return x;
+}
+
+template <typename T, std::size_t M>
+T Value(const Dual<T, M> & x)
+{
+	return x.value;
+}
+
+/**
+ * Jacobian of a function from N numbers to R numbers at x, by one evaluation
+ * on duals with input i seeded along direction i.
+ *
+ * f : called as f(const Dual<double, N> in[], Dual<double, N> out[]).
+ * const double x[] : N inputs to differentiate at.
+ * double value[] : filled with the R outputs of f at x.
+ * double J[] : filled with the R by N row major Jacobian,
+ * 	J[i*N + j] = d out_i / d in_j.
+ */
+template <std::size_t N, std::size_t R, typename F>
+void DualJacobian(F f, const double x[], double value[], double J[])
+{
+	Dual<double, N> in[N];
+	Dual<double, N> out[R];
+
+	for (std::size_t j = 0; j != N; j++)
+		in[j] = Dual<double, N>(x[j], j);
+
+	f(in, out);
+
+	for (std::size_t i = 0; i != R; i++)
+	{
+		value[i] = out[i].value;
+		for (std::size_t j = 0; j != N; j++)
+			J[i*N + j] = out[i].d[j];
+	}
+}
+
+#endif
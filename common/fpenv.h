@@ -0,0 +1,341 @@
+/**
+ * Limits and measured behaviour of the floating point environment.
+ *
+ * The limits of each arithmetic type are derived at compile time, without
+ * the overflowing loops of the original worksheet1 probes (overflowing a
+ * signed int is undefined behaviour, so the compiler may remove such a loop
+ * or never end it). Each derivation is checked against std::numeric_limits by
+ * static_assert, so a platform where they disagree fails to compile.
+ *
+ * What the limits don't say is how fast arithmetic is. Operations on
+ * subnormal numbers (smaller than the smallest normal number) take a slow
+ * path on many processors, and long double is computed on the x87 unit on
+ * x86. MeasureFloatingPoint times these, so that numerical kernels can choose
+ * a precision, and whether to flush subnormals to zero (see FlushDenormals),
+ * from measurements on the machine they run on.
+ *
+ * Shared between the worksheets: the limit probes of worksheet1, and the
+ * stiff integrator comparison of worksheet3 (stiff.cpp), whose solutions
+ * decay into the subnormal range.
+ */
+
+#ifndef FPENV_H
+#define FPENV_H
+
+#include <cstddef>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+
+// Flush to zero (FTZ) and denormals are zero (DAZ) are bits of the SSE
+// control register, MXCSR.
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FPENV_HAS_MXCSR 1
+#else
+#define FPENV_HAS_MXCSR 0
+#endif
+
+/**
+ * Largest value of an integer type: all bits set, less the sign bit if it
+ * has one. Needs no arithmetic that can overflow.
+ */
+template <typename T>
+constexpr T MaxOf()
+{
+	return std::is_signed<T>::value
+		? (T)((typename std::make_unsigned<T>::type)~(typename std::make_unsigned<T>::type)0 >> 1)
+		: (T)~(T)0;
+}
+
+// bool has no unsigned counterpart for the above.
+template <>
+constexpr bool MaxOf<bool>()
+{
+	return true;
+}
+
+/**
+ * Lowest value of an integer type: zero if unsigned, otherwise one below
+ * -MaxOf, as in two's complement.
+ */
+template <typename T>
+constexpr T LowestOf()
+{
+	return std::is_signed<T>::value ? (T)(-MaxOf<T>() - 1) : T(0);
+}
+
+template <typename T>
+constexpr T Square(T x)
+{
+	return x * x;
+}
+
+/**
+ * 2^n in a floating point type, exact down to the smallest subnormal. Found
+ * by repeated squaring, so the recursion is only O(log n) deep even for the
+ * exponents of long double, and every intermediate value lies between 1 and
+ * the result, so none underflows or overflows.
+ */
+template <typename T>
+constexpr T Power2(int n)
+{
+	return n == 0 ? T(1)
+		: n % 2 != 0 ? (n > 0 ? T(2) : T(0.5)) * Power2<T>(n > 0 ? n - 1 : n + 1)
+		: Square(Power2<T>(n / 2));
+}
+
+/**
+ * Difference between 1 and the next representable value, for a type with a
+ * significand of std::numeric_limits<T>::digits bits.
+ */
+template <typename T>
+constexpr T Epsilon()
+{
+	return Power2<T>(1 - std::numeric_limits<T>::digits);
+}
+
+/**
+ * Largest finite value: every bit of the significand set, at the largest
+ * exponent. The loop in worksheet1 found only the largest power of two.
+ */
+template <typename T>
+constexpr T LargestFinite()
+{
+	return (T(2) - Power2<T>(1 - std::numeric_limits<T>::digits)) * Power2<T>(std::numeric_limits<T>::max_exponent - 1);
+}
+
+/**
+ * Smallest positive normal and subnormal values.
+ */
+template <typename T>
+constexpr T SmallestNormal()
+{
+	return Power2<T>(std::numeric_limits<T>::min_exponent - 1);
+}
+
+template <typename T>
+constexpr T SmallestSubnormal()
+{
+	return Power2<T>(std::numeric_limits<T>::min_exponent - std::numeric_limits<T>::digits);
+}
+
+/**
+ * Number of decimal places n for which 1 + 10^-n still differs from 1 in T,
+ * with 0.1, 0.01, ... formed by repeated division by 10 as the worksheet1
+ * probe did. Not std::numeric_limits<T>::digits10, which counts the decimal
+ * digits that survive a round trip through T (6 for float, where 1 + 1e-7f
+ * still differs from 1 and this gives 7).
+ */
+template <typename T>
+constexpr int DecimalPlaces(int n = 1, T fluctuation = T(0.1))
+{
+	return T(1) + fluctuation / 10 != T(1) ? DecimalPlaces<T>(n + 1, fluctuation / 10) : n;
+}
+
+static_assert(MaxOf<bool>() == std::numeric_limits<bool>::max(), "bool");
+static_assert(MaxOf<char>() == std::numeric_limits<char>::max(), "char");
+static_assert(MaxOf<signed char>() == std::numeric_limits<signed char>::max(), "signed char");
+static_assert(MaxOf<unsigned char>() == std::numeric_limits<unsigned char>::max(), "unsigned char");
+static_assert(MaxOf<wchar_t>() == std::numeric_limits<wchar_t>::max(), "wchar_t");
+static_assert(MaxOf<char16_t>() == std::numeric_limits<char16_t>::max(), "char16_t");
+static_assert(MaxOf<char32_t>() == std::numeric_limits<char32_t>::max(), "char32_t");
+static_assert(MaxOf<short>() == std::numeric_limits<short>::max(), "short");
+static_assert(MaxOf<unsigned short>() == std::numeric_limits<unsigned short>::max(), "unsigned short");
+static_assert(MaxOf<int>() == std::numeric_limits<int>::max(), "int");
+static_assert(MaxOf<unsigned int>() == std::numeric_limits<unsigned int>::max(), "unsigned int");
+static_assert(MaxOf<long>() == std::numeric_limits<long>::max(), "long");
+static_assert(MaxOf<unsigned long>() == std::numeric_limits<unsigned long>::max(), "unsigned long");
+static_assert(MaxOf<long long>() == std::numeric_limits<long long>::max(), "long long");
+static_assert(MaxOf<unsigned long long>() == std::numeric_limits<unsigned long long>::max(), "unsigned long long");
+
+static_assert(LowestOf<bool>() == std::numeric_limits<bool>::lowest(), "bool lowest");
+static_assert(LowestOf<char>() == std::numeric_limits<char>::lowest(), "char lowest");
+static_assert(LowestOf<signed char>() == std::numeric_limits<signed char>::lowest(), "signed char lowest");
+static_assert(LowestOf<wchar_t>() == std::numeric_limits<wchar_t>::lowest(), "wchar_t lowest");
+static_assert(LowestOf<short>() == std::numeric_limits<short>::lowest(), "short lowest");
+static_assert(LowestOf<int>() == std::numeric_limits<int>::lowest(), "int lowest");
+static_assert(LowestOf<long>() == std::numeric_limits<long>::lowest(), "long lowest");
+static_assert(LowestOf<long long>() == std::numeric_limits<long long>::lowest(), "long long lowest");
+
+static_assert(Epsilon<float>() == std::numeric_limits<float>::epsilon(), "float epsilon");
+static_assert(Epsilon<double>() == std::numeric_limits<double>::epsilon(), "double epsilon");
+static_assert(Epsilon<long double>() == std::numeric_limits<long double>::epsilon(), "long double epsilon");
+static_assert(LargestFinite<float>() == std::numeric_limits<float>::max(), "float max");
+static_assert(LargestFinite<double>() == std::numeric_limits<double>::max(), "double max");
+static_assert(LargestFinite<long double>() == std::numeric_limits<long double>::max(), "long double max");
+static_assert(SmallestNormal<float>() == std::numeric_limits<float>::min(), "float min");
+static_assert(SmallestNormal<double>() == std::numeric_limits<double>::min(), "double min");
+static_assert(SmallestNormal<long double>() == std::numeric_limits<long double>::min(), "long double min");
+
+/**
+ * While in scope, sets flush to zero and denormals are zero, so subnormal
+ * results are replaced by zero and subnormal inputs are read as zero. The
+ * previous mode is restored on leaving scope. Only affects SSE arithmetic
+ * (float and double on x86-64), not the x87 long double, and does nothing
+ * where MXCSR doesn't exist.
+ */
+class FlushDenormals
+{
+public:
+	explicit FlushDenormals(bool flush = true)
+	{
+#if FPENV_HAS_MXCSR
+		saved = _mm_getcsr();
+		if (flush)
+			_mm_setcsr(saved | 0x8040);
+#endif
+	}
+
+	~FlushDenormals()
+	{
+#if FPENV_HAS_MXCSR
+		_mm_setcsr(saved);
+#endif
+	}
+
+	static bool Supported()
+	{
+		return FPENV_HAS_MXCSR;
+	}
+
+	FlushDenormals(const FlushDenormals &) = delete;
+	FlushDenormals & operator=(const FlushDenormals &) = delete;
+
+private:
+#if FPENV_HAS_MXCSR
+	unsigned int saved;
+#endif
+};
+
+/**
+ * Seconds taken by operations multiply-adds y = a y + b, spread over eight
+ * independent chains so that the rate measured is throughput rather than the
+ * latency of one chain. Each chain converges to b / (1 - a), so with a = 1/2
+ * and b subnormal every operation has subnormal operands and result. The
+ * inputs are read through volatiles so the compiler can't fold the loop.
+ *
+ * std::size_t operations : number of multiply-adds, a multiple of 8.
+ * T b : offset, choosing normal or subnormal values.
+ * return : best time in seconds of three runs.
+ */
+template <typename T>
+double TimeMultiplyAdds(std::size_t operations, T b)
+{
+	volatile T va = T(0.5);
+	volatile T vb = b;
+	T a = va;
+	T offset = vb;
+
+	double best = std::numeric_limits<double>::infinity();
+
+	for (int run = 0; run != 3; run++)
+	{
+		T y[8];
+		for (int k = 0; k != 8; k++)
+			y[k] = offset * (k + 1);
+
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i != operations / 8; i++)
+			for (int k = 0; k != 8; k++)
+				y[k] = a * y[k] + offset;
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		volatile T sink = y[0] + y[1] + y[2] + y[3] + y[4] + y[5] + y[6] + y[7];
+		(void)sink;
+
+		best = std::min(best, seconds);
+	}
+
+	return best;
+}
+
+/**
+ * Measured speed of one floating point type.
+ *
+ * rate : multiply-adds per second on normal numbers.
+ * subnormalPenalty : time on subnormal numbers over time on normal numbers.
+ * flushedPenalty : the same with FlushDenormals set, equal to
+ * 	subnormalPenalty where flushing doesn't apply to the type.
+ */
+struct FloatingPointSpeed
+{
+	double rate;
+	double subnormalPenalty;
+	double flushedPenalty;
+};
+
+/**
+ * Measure the speed of T. Subnormal operations can be hundreds of times
+ * slower, so the penalties are timed with a sixteenth of the operations.
+ *
+ * std::size_t operations : multiply-adds for the rate.
+ */
+template <typename T>
+FloatingPointSpeed MeasureSpeed(std::size_t operations)
+{
+	operations = std::max<std::size_t>(128, operations / 128 * 128);
+	std::size_t fewer = operations / 16;
+	T subnormal = SmallestNormal<T>() / 4;
+
+	FloatingPointSpeed speed;
+	speed.rate = operations / TimeMultiplyAdds<T>(operations, T(1));
+	speed.subnormalPenalty = TimeMultiplyAdds<T>(fewer, subnormal) / TimeMultiplyAdds<T>(fewer, T(1));
+	speed.flushedPenalty = speed.subnormalPenalty;
+
+	if (FlushDenormals::Supported() && !std::is_same<T, long double>::value)
+	{
+		FlushDenormals flush;
+		speed.flushedPenalty = TimeMultiplyAdds<T>(fewer, subnormal) / TimeMultiplyAdds<T>(fewer, T(1));
+	}
+
+	return speed;
+}
+
+/**
+ * Speeds of float, double and long double on this machine.
+ */
+struct FloatingPointProfile
+{
+	FloatingPointSpeed single;
+	FloatingPointSpeed doublePrecision;
+	FloatingPointSpeed extended;
+	bool flushSupported;
+
+	/**
+	 * Whether a kernel in T should run with FlushDenormals: only where it
+	 * removes a slow down worth having. Flushing changes results near the
+	 * underflow threshold, so kernels which need gradual underflow shouldn't.
+	 */
+	template <typename T>
+	bool PreferFlush() const
+	{
+		const FloatingPointSpeed & speed = Speed<T>();
+		return speed.subnormalPenalty > 1.5 && speed.flushedPenalty < speed.subnormalPenalty / 1.5;
+	}
+
+	template <typename T>
+	const FloatingPointSpeed & Speed() const
+	{
+		return std::is_same<T, float>::value ? single : std::is_same<T, double>::value ? doublePrecision : extended;
+	}
+};
+
+/**
+ * Time each floating point type, taking a fraction of a second with the
+ * default number of operations.
+ *
+ * std::size_t operations : multiply-adds per timing.
+ */
+inline FloatingPointProfile MeasureFloatingPoint(std::size_t operations = 1 << 22)
+{
+	FloatingPointProfile profile;
+	profile.single = MeasureSpeed<float>(operations);
+	profile.doublePrecision = MeasureSpeed<double>(operations);
+	profile.extended = MeasureSpeed<long double>(operations);
+	profile.flushSupported = FlushDenormals::Supported();
+	return profile;
+}
+
+#endif
@@ -32,7 +32,8 @@ executables_to_compile={"w1q2.cpp" : "hello",
         "w1q3d.cpp" : "sums",
         "w1q4.cpp" : "silverratio",
         "w1q6.cpp" : "bisector",
-        "w1q7.cpp" : "newton-raphson"}
+        "w1q7.cpp" : "newton-raphson",
+        "fpenv.cpp" : "fpenv"}
 
 print "Beginning build."
 
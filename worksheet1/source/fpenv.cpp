@@ -0,0 +1,106 @@
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include "../../common/fpenv.h"
+/**
+ * This code prints the limits of every arithmetic type, which are known at
+ * compile time (see fpenv.h), and then measures how fast float, double and
+ * long double arithmetic is on this machine, including the slow down on
+ * subnormal numbers and how much flushing them to zero recovers.
+ */
+using namespace std;
+
+/**
+ * Print a row of the integer table: bits, lowest and largest value, the
+ * values derived in fpenv.h.
+ *
+ * Name : Name of the type.
+ */
+template <typename T>
+void Print_Integer(const char * Name){
+	//Unary + prints character types as numbers.
+	cout << left << setw(22) << Name
+		<< setw(8) << numeric_limits<T>::digits + numeric_limits<T>::is_signed
+		<< setw(28) << +LowestOf<T>()
+		<< setw(28) << +MaxOf<T>() << endl;
+}
+
+/**
+ * Print a row of the floating point table: significand bits, decimal digits,
+ * epsilon, smallest subnormal, smallest normal and largest value, each to
+ * enough digits to identify it exactly.
+ *
+ * Name : Name of the type.
+ */
+template <typename T>
+void Print_Floating(const char * Name){
+	cout << left << setw(14) << Name
+		<< setw(8) << numeric_limits<T>::digits
+		<< setw(8) << numeric_limits<T>::digits10
+		<< setprecision(numeric_limits<T>::max_digits10)
+		<< setw(30) << Epsilon<T>()
+		<< setw(30) << SmallestSubnormal<T>()
+		<< setw(30) << SmallestNormal<T>()
+		<< setw(30) << LargestFinite<T>() << endl;
+}
+
+/**
+ * Print a row of the speed table.
+ *
+ * Name : Name of the type.
+ * Speed : Measured speed of the type.
+ * Double_Rate : Rate of double, to compare against.
+ * Flush : Whether flushing subnormals is worth it for this type.
+ */
+void Print_Speed(const char * Name, const FloatingPointSpeed & Speed, double Double_Rate, bool Flush){
+	cout << left << setw(14) << Name << fixed << setprecision(1)
+		<< setw(16) << Speed.rate / 1e6
+		<< setw(16) << setprecision(3) << Speed.rate / Double_Rate
+		<< setw(16) << setprecision(1) << Speed.subnormalPenalty
+		<< setw(16) << Speed.flushedPenalty
+		<< (Flush ? "yes" : "no") << endl;
+	cout.unsetf(ios::fixed);
+}
+
+int main(int argc, char * argv[]){
+
+	cout << "Integer types" << endl;
+	cout << left << setw(22) << "Type" << setw(8) << "Bits" << setw(28) << "Lowest" << setw(28) << "Max" << endl;
+	Print_Integer<bool>("bool");
+	Print_Integer<char>("char");
+	Print_Integer<signed char>("signed char");
+	Print_Integer<unsigned char>("unsigned char");
+	Print_Integer<wchar_t>("wchar_t");
+	Print_Integer<char16_t>("char16_t");
+	Print_Integer<char32_t>("char32_t");
+	Print_Integer<short>("short");
+	Print_Integer<unsigned short>("unsigned short");
+	Print_Integer<int>("int");
+	Print_Integer<unsigned int>("unsigned int");
+	Print_Integer<long>("long");
+	Print_Integer<unsigned long>("unsigned long");
+	Print_Integer<long long>("long long");
+	Print_Integer<unsigned long long>("unsigned long long");
+
+	cout << endl << "Floating point types" << endl;
+	cout << left << setw(14) << "Type" << setw(8) << "Bits" << setw(8) << "Digits" << setw(30) << "Epsilon"
+		<< setw(30) << "Smallest subnormal" << setw(30) << "Smallest normal" << setw(30) << "Max" << endl;
+	Print_Floating<float>("float");
+	Print_Floating<double>("double");
+	Print_Floating<long double>("long double");
+
+	cout << endl << "Measuring speed..." << endl;
+	FloatingPointProfile Profile = MeasureFloatingPoint();
+
+	cout << left << setw(14) << "Type" << setw(16) << "Mega ops/s" << setw(16) << "vs. double"
+		<< setw(16) << "Subnormal" << setw(16) << "FTZ/DAZ" << "Flush" << endl;
+	Print_Speed("float", Profile.single, Profile.doublePrecision.rate, Profile.PreferFlush<float>());
+	Print_Speed("double", Profile.doublePrecision, Profile.doublePrecision.rate, Profile.PreferFlush<double>());
+	Print_Speed("long double", Profile.extended, Profile.doublePrecision.rate, Profile.PreferFlush<long double>());
+
+	if (!Profile.flushSupported){
+		cout << "Flush to zero is not available on this processor." << endl;
+	}
+
+	return 0;
+}
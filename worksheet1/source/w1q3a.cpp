@@ -1,16 +1,14 @@
 #include <iostream>
+#include "../../common/fpenv.h"
 
 using namespace std;
 
 int main(int argc, char * argv[]){
 
-	int a = 0;
-	int b = 1;
-
-	while (a < b){
-		a++;
-		b++;	
-	}
+	//Counting up until a++ overflows is undefined behaviour, and takes 2^31
+	//steps when it happens to work. The largest int is all bits set except
+	//the sign bit, which is worked out at compile time instead.
+	constexpr int a = MaxOf<int>();
 
 	std::cout << "Max int is: " << a << std::endl;
 
@@ -1,29 +1,27 @@
 #include <iostream>
 #include <limits>
+#include "../../common/fpenv.h"
 
 using namespace std;
 
 int main(int argv, char * argc[]){
 
-	float a = 0.0;
-	float b = 1.0;
+	//Doubling until infinity only finds the largest power of two. The
+	//largest value has every bit of the significand set as well, and is
+	//worked out at compile time (see fpenv.h).
+	constexpr float a = Power2<float>(std::numeric_limits<float>::max_exponent - 1);
+	constexpr float b = LargestFinite<float>();
 
-	while (b != std::numeric_limits<float>::infinity()) {
-		a = b;
-		b *= 2;
-	}
-	
-	std::cout << "Approx highest float is: " << a << std::endl;
+	std::cout.precision(std::numeric_limits<float>::max_digits10);
+	std::cout << "Highest power of two float is: " << a << std::endl;
+	std::cout << "Highest float is: " << b << std::endl;
 
-	double c = 0.0;
-	double d = 1.0;
+	constexpr double c = Power2<double>(std::numeric_limits<double>::max_exponent - 1);
+	constexpr double d = LargestFinite<double>();
 
-	while (d != std::numeric_limits<double>::infinity()) {
-		c = d;
-		d *= 2;
-	}
-
-	std::cout << "Approx highest double is: " << c << std::endl;
+	std::cout.precision(std::numeric_limits<double>::max_digits10);
+	std::cout << "Highest power of two double is: " << c << std::endl;
+	std::cout << "Highest double is: " << d << std::endl;
 
 	return 0;
 
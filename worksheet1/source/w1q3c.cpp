@@ -1,43 +1,42 @@
 #include <iostream>
+#include <limits>
+#include "../../common/fpenv.h"
 
 using namespace std;
 
-int main(int argc, char * argv[]){
-	
-	float unit_float;
-	float fluctuation_float = 0.1;
-	int count = 0;
+/**
+ * Print the machine epsilon of a type, the gap between 1 and the next value,
+ * with the number of decimal places of 0.1, 0.01, ... that can be added to 1
+ * and still change it, and for comparison the number of decimal digits that
+ * survive a round trip through the type (digits10). All are known at compile
+ * time, rather than found by adding smaller and smaller fluctuations until
+ * 1 + fluctuation == 1.
+ *
+ * Name : Name of the type.
+ */
+template<typename precision> void Print_Epsilon(const char * Name) {
+
+	constexpr precision epsilon = Epsilon<precision>();
+	constexpr int places = DecimalPlaces<precision>();
+
 	cout.precision(20);
+	cout << Name << " epsilon:\t" << epsilon << endl;
+	cout << Name << " significand bits:\t" << numeric_limits<precision>::digits << endl;
+	cout << Name << " decimal places:\t" << places << endl;
+	cout << Name << " decimal digits:\t" << numeric_limits<precision>::digits10 << endl;
+	cout << "1 + epsilon:\t\t" << precision(1) + epsilon << endl;
+	cout << "1 + epsilon / 2:\t" << precision(1) + epsilon / 2 << endl;
 
-	cout << "Precision\tResult" << endl;
-	do {
-		unit_float = 1.0;
-		unit_float += fluctuation_float;
-		count++;
-		fluctuation_float /= 10;
+}
 
-		cout << count << "\t\t" << unit_float << endl;
-		
-	} while (unit_float != 1);
+int main(int argc, char * argv[]){
 
-	double unit_double;
-	double fluctuation_double = 0.1;
-	count = 0;
+	Print_Epsilon<float>("Float");
 
 	cout << endl;
 	cout << endl;
 
-	cout << "Precision\tResult" << endl;
-
-	do {
-		unit_double = 1.0;
-		unit_double += fluctuation_double;
-		count++;
-		fluctuation_double /= 10;
-
-		cout << count << "\t\t" << unit_double << endl;
-
-	} while (unit_double != 1);
+	Print_Epsilon<double>("Double");
 
 	return 0;
 }
@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <cmath>
 #include <fstream>
+#include "../../common/dual.h"
 /**
  * This code outputs the results for a Bisection method run and two
  * Newton-Raphson runs with different initial values. The results
@@ -14,21 +15,16 @@ using namespace std;
 //Global count for use in outputs
 int count = 0;
 
-//Defined function to solve.
-double Function(double Input_Value){
+//Defined function to solve. Templated so it can also be evaluated on dual
+//numbers, which gives its derivative for Newton-Raphson.
+template <typename T>
+T Function(T Input_Value){
 	return (Input_Value*Input_Value*Input_Value + 
 			7*Input_Value*Input_Value -
 			6*Input_Value +
 			15);
 }
 
-//Defined derivative of function to solve.
-double D_Function(double Input_Value){
-	return (3*Input_Value*Input_Value +
-			14*Input_Value -
-			6);
-}
-
 /**
  * Bisection function to recursively find the root of an equation using
  * the bisection method.
@@ -66,7 +62,8 @@ double Bisection(double Lower_Bound, double Upper_Bound, double Precision, ofstr
 
 /**
  * Function that uses the Newton-Raphson algorithm recursively to find
- * the root of the Function defined by Function and D_Function.
+ * the root of the Function defined by Function. The derivative is found by
+ * evaluating Function on a dual number, so no derivative has to be written.
  *
  * x : Initial guess for the Newton-Raphson method.
  * Precision : Final precision for the output.
@@ -75,7 +72,8 @@ double Bisection(double Lower_Bound, double Upper_Bound, double Precision, ofstr
  */ 	
 double Newton_Raphson(double x, double Precision, ofstream & output){
 
-	double result = x - Function(x)/D_Function(x);
+	Dual<double> fx = Function(Dual<double>(x, 0));
+	double result = x - fx.value/fx.d[0];
 
 	//Output here is iteration number, convergence and result at iteration.
 	output << count << "," << abs(result - x) << "," << result << endl;
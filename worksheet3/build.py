@@ -18,7 +18,7 @@ parser.add_argument('--sources', '-s', nargs='*', help='List of specific sources
 parser.add_argument('--cygwin', '-c', help='Compile for windows lol.', action='store_true')
 
 compiler="g++"
-compiler_flags=["-Wall", "-O2", "-I/usr/include", "-L/usr/lib", "-lgsl", "-lgslcblas", "-lm"]
+compiler_flags=["-Wall", "-O2", "-std=c++11", "-pthread", "-I/usr/include", "-L/usr/lib", "-lgsl", "-lgslcblas", "-lm"]
 source_dir="source/"
 object_dir="images/"
 success = True
@@ -26,7 +26,12 @@ success = True
 executables_to_compile={"question1.cpp" : "euler",
 			"question5.cpp" : "rungekutta",
 			"question5-2.cpp" : "gsl_rk",
-                        "question5-3.cpp" : "adap_gsl_rk"}
+                        "question5-3.cpp" : "adap_gsl_rk",
+                        "ensemble.cpp" : "ensemble",
+                        "stiff.cpp" : "stiff",
+                        "chain.cpp" : "chain",
+                        "sde.cpp" : "sde",
+                        "bvp.cpp" : "bvp"}
 
 print
 print "Beginning build."
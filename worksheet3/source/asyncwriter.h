@@ -0,0 +1,250 @@
+/**
+ * Asynchronous output of trajectory records.
+ *
+ * Formatting six %-20.15f columns with fprintf costs more than a step of a
+ * small system, so at high step counts writing rows inline dominates the run
+ * time. AsyncWriter moves that work to a background thread: the integrating
+ * thread pushes raw records (a few doubles) into a fixed size ring buffer and
+ * carries on, while the writer thread pops them, formats them and writes them
+ * to file.
+ *
+ * The ring buffer has a single producer and a single consumer, so it needs no
+ * locks: each side owns one index and publishes it with release ordering.
+ * If the writer falls behind and the buffer fills, the producer waits for
+ * space (backpressure) rather than dropping records or growing memory. Every
+ * record pushed is written: Close, or the destructor, waits for the writer to
+ * drain the buffer and flushes the file.
+ *
+ * When the buffer is empty the writer spins briefly, then sleeps on a
+ * condition variable, so it doesn't take a core from the solver while there
+ * is nothing to write. The producer only takes the lock to wake it when it
+ * is actually asleep, so writing a record stays lock free.
+ */
+
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Bounded single producer, single consumer queue. Push must only be called
+ * from one thread and Pop from one (other) thread.
+ */
+template <typename Record>
+class RingBuffer
+{
+public:
+	/**
+	 * std::size_t capacity : number of slots, rounded up to a power of two.
+	 */
+	explicit RingBuffer(std::size_t capacity) :
+		head(0), tail(0)
+	{
+		std::size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	/**
+	 * Add a record, if there is room.
+	 *
+	 * return : false if the buffer is full.
+	 */
+	bool Push(const Record & record)
+	{
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == slots.size())
+			return false;
+
+		slots[h & mask] = record;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Remove the oldest record, if there is one.
+	 *
+	 * return : false if the buffer is empty.
+	 */
+	bool Pop(Record & record)
+	{
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+			return false;
+
+		record = slots[t & mask];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Whether there is nothing to pop, for the consumer.
+	bool Empty() const
+	{
+		return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<Record> slots;
+	std::size_t mask;
+
+	// Next slot to write (owned by the producer) and to read (owned by the
+	// consumer), padded onto separate cache lines so the two threads don't
+	// contend. Padding rather than alignas keeps the buffer allocatable with
+	// plain new.
+	std::atomic<std::size_t> head;
+	char padding[64];
+	std::atomic<std::size_t> tail;
+};
+
+/**
+ * Writes records to a file on a background thread.
+ *
+ * Format is called on the writer thread as format(FILE * file,
+ * const Record & record) and writes one record.
+ */
+template <typename Record, typename Format>
+class AsyncWriter
+{
+public:
+	// Number of times the producer found the buffer full and had to wait.
+	long long stalls;
+
+	/**
+	 * Start the writer thread. The file stays owned by the caller, but must
+	 * not be used until Close has been called.
+	 *
+	 * FILE * file : open file to write to.
+	 * Format format : record formatter.
+	 * std::size_t capacity : records held in the buffer.
+	 */
+	AsyncWriter(FILE * file, Format format, std::size_t capacity = 1 << 16) :
+		stalls(0), file(file), format(format), buffer(capacity), done(false), sleeping(false)
+	{
+		writer = std::thread(&AsyncWriter::Run, this);
+	}
+
+	~AsyncWriter()
+	{
+		Close();
+	}
+
+	/**
+	 * Queue a record for writing, waiting for space if the buffer is full.
+	 */
+	void Write(const Record & record)
+	{
+		if (!buffer.Push(record))
+		{
+			stalls++;
+			while (!buffer.Push(record))
+				std::this_thread::yield();
+		}
+
+		Wake();
+	}
+
+	/**
+	 * Write every queued record, flush the file and stop the writer thread.
+	 * Further calls do nothing.
+	 */
+	void Close()
+	{
+		if (!writer.joinable())
+			return;
+
+		done.store(true, std::memory_order_release);
+		Wake();
+		writer.join();
+		fflush(file);
+	}
+
+private:
+	FILE * file;
+	Format format;
+	RingBuffer<Record> buffer;
+	std::atomic<bool> done;
+	std::thread writer;
+
+	// Set by the writer while it sleeps on wake.
+	std::atomic<bool> sleeping;
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	// Times the writer finds the buffer empty before going to sleep.
+	static const int spins = 64;
+
+	/**
+	 * Wake the writer if it is asleep. The fence pairs with the one in
+	 * Sleep: either the writer sees the record (or done) before sleeping,
+	 * or this sees it sleeping and notifies it.
+	 */
+	void Wake()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			wake.notify_one();
+		}
+	}
+
+	void Sleep()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		while (buffer.Empty() && !done.load(std::memory_order_acquire))
+			wake.wait(lock);
+
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+
+	void Run()
+	{
+		Record record;
+		int idle = 0;
+
+		while (true)
+		{
+			if (buffer.Pop(record))
+			{
+				format(file, record);
+				idle = 0;
+				continue;
+			}
+
+			// Only stop once the producer is finished and everything it
+			// pushed before finishing has been written.
+			if (done.load(std::memory_order_acquire))
+			{
+				while (buffer.Pop(record))
+					format(file, record);
+				return;
+			}
+
+			if (++idle < spins)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				Sleep();
+				idle = 0;
+			}
+		}
+	}
+
+	AsyncWriter(const AsyncWriter &);
+	AsyncWriter & operator=(const AsyncWriter &);
+};
+
+#endif
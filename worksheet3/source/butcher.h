@@ -0,0 +1,422 @@
+/**
+ * Explicit Runge-Kutta methods defined by their Butcher tableaux.
+ *
+ * A method is a struct giving its number of stages and orders, and a
+ * constexpr function returning its tableau: nodes c, coefficients a (lower
+ * triangular) and weights b, plus for embedded pairs the differences e
+ * between the weights of the two solutions, used as an error estimate.
+ *
+ * The stepper reads the coefficients as compile time constants, and the
+ * stages and the sums within them are unrolled by template recursion. Terms
+ * with a zero coefficient are dropped by the compiler, so a method costs the
+ * same as writing its stages out by hand, and a new method is added by
+ * writing down its tableau. The derivative is a template parameter, as in
+ * rungekutta.h, so it can be inlined into the stages.
+ *
+ * Only explicit methods are supported: c[0] = 0 and a is strictly lower
+ * triangular.
+ */
+
+#ifndef BUTCHER_H
+#define BUTCHER_H
+
+#include <cstddef>
+#include "statevector.h"
+
+/**
+ * Butcher tableau of an S stage explicit method.
+ *
+ * c : nodes, the stage times as fractions of the step.
+ * a : stage coefficients, a[i][j] for j < i.
+ * b : weights of the solution.
+ * e : weights of the error estimate (b minus the weights of the embedded
+ * 	solution), zero if the method has none.
+ */
+template <int S>
+struct Tableau
+{
+	double c[S];
+	double a[S][S];
+	double b[S];
+	double e[S];
+};
+
+/**
+ * Forward Euler, order 1.
+ */
+struct EulerMethod
+{
+	static constexpr int stages = 1;
+	static constexpr int order = 1;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<1> Coefficients()
+	{
+		return Tableau<1>{{0}, {{0}}, {1}, {0}};
+	}
+};
+
+/**
+ * Explicit midpoint method, order 2. The method of RungeKuttaStep.
+ */
+struct Midpoint
+{
+	static constexpr int stages = 2;
+	static constexpr int order = 2;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<2> Coefficients()
+	{
+		return Tableau<2>{{0, 0.5}, {{0, 0}, {0.5, 0}}, {0, 1}, {0, 0}};
+	}
+};
+
+/**
+ * Heun's method (explicit trapezoidal rule), order 2.
+ */
+struct Heun
+{
+	static constexpr int stages = 2;
+	static constexpr int order = 2;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<2> Coefficients()
+	{
+		return Tableau<2>{{0, 1}, {{0, 0}, {1, 0}}, {0.5, 0.5}, {0, 0}};
+	}
+};
+
+/**
+ * Ralston's method, the second order method of least truncation error.
+ */
+struct Ralston
+{
+	static constexpr int stages = 2;
+	static constexpr int order = 2;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<2> Coefficients()
+	{
+		return Tableau<2>{{0, 2.0/3}, {{0, 0}, {2.0/3, 0}}, {0.25, 0.75}, {0, 0}};
+	}
+};
+
+/**
+ * Kutta's third order method.
+ */
+struct KuttaThird
+{
+	static constexpr int stages = 3;
+	static constexpr int order = 3;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<3> Coefficients()
+	{
+		return Tableau<3>{{0, 0.5, 1},
+			{{0, 0, 0}, {0.5, 0, 0}, {-1, 2, 0}},
+			{1.0/6, 2.0/3, 1.0/6}, {0, 0, 0}};
+	}
+};
+
+/**
+ * Third order strong stability preserving method of Shu and Osher
+ * (SSPRK3), which keeps any norm bound of forward Euler steps.
+ */
+struct SSPThird
+{
+	static constexpr int stages = 3;
+	static constexpr int order = 3;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<3> Coefficients()
+	{
+		return Tableau<3>{{0, 1, 0.5},
+			{{0, 0, 0}, {1, 0, 0}, {0.25, 0.25, 0}},
+			{1.0/6, 1.0/6, 2.0/3}, {0, 0, 0}};
+	}
+};
+
+/**
+ * The classical fourth order method, as gsl_odeiv2_step_rk4.
+ */
+struct ClassicalFourth
+{
+	static constexpr int stages = 4;
+	static constexpr int order = 4;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<4> Coefficients()
+	{
+		return Tableau<4>{{0, 0.5, 0.5, 1},
+			{{0, 0, 0, 0}, {0.5, 0, 0, 0}, {0, 0.5, 0, 0}, {0, 0, 1, 0}},
+			{1.0/6, 1.0/3, 1.0/3, 1.0/6}, {0, 0, 0, 0}};
+	}
+};
+
+/**
+ * Kutta's 3/8 rule, fourth order.
+ */
+struct ThreeEighths
+{
+	static constexpr int stages = 4;
+	static constexpr int order = 4;
+	static constexpr int embeddedOrder = 0;
+
+	static constexpr Tableau<4> Coefficients()
+	{
+		return Tableau<4>{{0, 1.0/3, 2.0/3, 1},
+			{{0, 0, 0, 0}, {1.0/3, 0, 0, 0}, {-1.0/3, 1, 0, 0}, {1, -1, 1, 0}},
+			{0.125, 0.375, 0.375, 0.125}, {0, 0, 0, 0}};
+	}
+};
+
+/**
+ * Heun-Euler 2(1) embedded pair: Heun's method with forward Euler as the
+ * error estimate.
+ */
+struct HeunEuler
+{
+	static constexpr int stages = 2;
+	static constexpr int order = 2;
+	static constexpr int embeddedOrder = 1;
+
+	static constexpr Tableau<2> Coefficients()
+	{
+		return Tableau<2>{{0, 1}, {{0, 0}, {1, 0}}, {0.5, 0.5}, {-0.5, 0.5}};
+	}
+};
+
+/**
+ * Bogacki-Shampine 3(2) embedded pair. The fourth stage is the derivative at
+ * the end of the step.
+ */
+struct BogackiShampine
+{
+	static constexpr int stages = 4;
+	static constexpr int order = 3;
+	static constexpr int embeddedOrder = 2;
+
+	static constexpr Tableau<4> Coefficients()
+	{
+		return Tableau<4>{{0, 0.5, 0.75, 1},
+			{{0, 0, 0, 0}, {0.5, 0, 0, 0}, {0, 0.75, 0, 0}, {2.0/9, 1.0/3, 4.0/9, 0}},
+			{2.0/9, 1.0/3, 4.0/9, 0},
+			{2.0/9 - 7.0/24, 1.0/3 - 0.25, 4.0/9 - 1.0/3, -0.125}};
+	}
+};
+
+/**
+ * Cash-Karp 5(4) embedded pair, as gsl_odeiv2_step_rkck.
+ */
+struct CashKarp
+{
+	static constexpr int stages = 6;
+	static constexpr int order = 5;
+	static constexpr int embeddedOrder = 4;
+
+	static constexpr Tableau<6> Coefficients()
+	{
+		return Tableau<6>{{0, 0.2, 0.3, 0.6, 1, 0.875},
+			{{0, 0, 0, 0, 0, 0},
+			{0.2, 0, 0, 0, 0, 0},
+			{3.0/40, 9.0/40, 0, 0, 0, 0},
+			{0.3, -0.9, 1.2, 0, 0, 0},
+			{-11.0/54, 2.5, -70.0/27, 35.0/27, 0, 0},
+			{1631.0/55296, 175.0/512, 575.0/13824, 44275.0/110592, 253.0/4096, 0}},
+			{37.0/378, 0, 250.0/621, 125.0/594, 0, 512.0/1771},
+			{37.0/378 - 2825.0/27648, 0, 250.0/621 - 18575.0/48384,
+				125.0/594 - 13525.0/55296, -277.0/14336, 512.0/1771 - 0.25}};
+	}
+};
+
+// Single coefficients of method M as compile time constants.
+template <typename M, int I, int J>
+struct ButcherA
+{
+	static constexpr double value = M::Coefficients().a[I][J];
+};
+
+template <typename M, int I>
+struct ButcherB
+{
+	static constexpr double value = M::Coefficients().b[I];
+};
+
+template <typename M, int I>
+struct ButcherC
+{
+	static constexpr double value = M::Coefficients().c[I];
+};
+
+template <typename M, int I>
+struct ButcherE
+{
+	static constexpr double value = M::Coefficients().e[I];
+};
+
+/**
+ * Adds h * sum over j < I of a[I][j] k[j] to a stage.
+ */
+template <typename M, int I, int J = 0, bool Done = (J == I)>
+struct ButcherStageSum
+{
+	template <std::size_t N, typename T>
+	static void Add(StateVector<N, T> & sum, const StateVector<N, T> k[], double h)
+	{
+		if (ButcherA<M, I, J>::value != 0)
+			sum += (h * ButcherA<M, I, J>::value) * k[J];
+		ButcherStageSum<M, I, J + 1>::Add(sum, k, h);
+	}
+};
+
+template <typename M, int I, int J>
+struct ButcherStageSum<M, I, J, true>
+{
+	template <std::size_t N, typename T>
+	static void Add(StateVector<N, T> &, const StateVector<N, T> [], double)
+	{
+	}
+};
+
+/**
+ * Adds h * sum over j of W<M, j>::value k[j], for weights W (ButcherB or
+ * ButcherE).
+ */
+template <typename M, template <typename, int> class W, int J = 0, bool Done = (J == M::stages)>
+struct ButcherWeightSum
+{
+	template <std::size_t N, typename T>
+	static void Add(StateVector<N, T> & sum, const StateVector<N, T> k[], double h)
+	{
+		if (W<M, J>::value != 0)
+			sum += (h * W<M, J>::value) * k[J];
+		ButcherWeightSum<M, W, J + 1>::Add(sum, k, h);
+	}
+};
+
+template <typename M, template <typename, int> class W, int J>
+struct ButcherWeightSum<M, W, J, true>
+{
+	template <std::size_t N, typename T>
+	static void Add(StateVector<N, T> &, const StateVector<N, T> [], double)
+	{
+	}
+};
+
+/**
+ * Computes stages I onwards, given k[0] and the stages before I.
+ */
+template <typename M, int I = 1, bool Done = (I == M::stages)>
+struct ButcherStages
+{
+	template <typename F, std::size_t N, typename T>
+	static void Compute(F & d, const StateVector<N, T> & y0, double t0, double h, StateVector<N, T> k[], StateVector<N, T> & stage)
+	{
+		stage = y0;
+		ButcherStageSum<M, I>::Add(stage, k, h);
+		k[I] = d(t0 + ButcherC<M, I>::value * h, stage);
+		ButcherStages<M, I + 1>::Compute(d, y0, t0, h, k, stage);
+	}
+};
+
+template <typename M, int I>
+struct ButcherStages<M, I, true>
+{
+	template <typename F, std::size_t N, typename T>
+	static void Compute(F &, const StateVector<N, T> &, double, double, StateVector<N, T> [], StateVector<N, T> &)
+	{
+	}
+};
+
+/**
+ * Stepper for an explicit method, holding the stage vectors so they are
+ * reused from step to step.
+ *
+ * Method is a tableau struct such as ClassicalFourth. F is the derivative,
+ * callable as d(double t, const StateVector<N, T> & y).
+ */
+template <typename Method, std::size_t N, typename T, typename F>
+class ExplicitRungeKutta
+{
+public:
+	// Number of derivative evaluations.
+	long long evaluations;
+
+	/**
+	 * F d : derivative function for the problem.
+	 */
+	explicit ExplicitRungeKutta(F d) :
+		evaluations(0), d(d)
+	{
+	}
+
+	/**
+	 * Advance y by one step.
+	 *
+	 * double t : time at the start of the step.
+	 * double h : width of step.
+	 * StateVector & y : state at t, updated to the state at t + h.
+	 */
+	void Step(double t, double h, StateVector<N, T> & y)
+	{
+		Stages(t, h, y);
+		ButcherWeightSum<Method, ButcherB>::Add(y, k, h);
+	}
+
+	/**
+	 * Advance y by one step of an embedded pair, also estimating the error
+	 * as the difference between the two solutions.
+	 *
+	 * double t : time at the start of the step.
+	 * double h : width of step.
+	 * StateVector & y : state at t, updated to the state at t + h.
+	 * StateVector & error : set to the error estimate.
+	 */
+	void Step(double t, double h, StateVector<N, T> & y, StateVector<N, T> & error)
+	{
+		static_assert(Method::embeddedOrder > 0, "Method has no embedded error estimate.");
+
+		Stages(t, h, y);
+		for (std::size_t i = 0; i != N; i++)
+			error[i] = 0;
+		ButcherWeightSum<Method, ButcherE>::Add(error, k, h);
+		ButcherWeightSum<Method, ButcherB>::Add(y, k, h);
+	}
+
+private:
+	F d;
+	StateVector<N, T> k[Method::stages];
+	StateVector<N, T> stage;
+
+	void Stages(double t, double h, const StateVector<N, T> & y)
+	{
+		k[0] = d(t, y);
+		ButcherStages<Method>::Compute(d, y, t, h, k, stage);
+		evaluations += Method::stages;
+	}
+};
+
+/**
+ * One step of an explicit method, without a stepper object.
+ *
+ * d : derivative function for the problem.
+ * StateVector y0 : value of y at start of step.
+ * double t0 : value of t at start of step.
+ * double h : width of step.
+ * return : estimate value of y at t0 + h.
+ */
+template <typename Method, typename F, std::size_t N, typename T>
+StateVector<N, T> ButcherStep(F d, const StateVector<N, T> & y0, double t0, double h)
+{
+	StateVector<N, T> k[Method::stages];
+	StateVector<N, T> stage;
+
+	k[0] = d(t0, y0);
+	ButcherStages<Method>::Compute(d, y0, t0, h, k, stage);
+
+	StateVector<N, T> y = y0;
+	ButcherWeightSum<Method, ButcherB>::Add(y, k, h);
+	return y;
+}
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * Source code for a program which solves two point boundary value problems
+ * by single or multiple shooting (see bvp.h), instead of adjusting startY by
+ * hand between trial integrations. Two problems are available, both written
+ * in terms of v and x as in question5.cpp:
+ *
+ * 	The oscillator v' = -x, x' = v, with x(0) = 0 and x(T) = X given.
+ * 	Troesch's problem v' = mu sinh(mu x), x' = v on [0, 1], with x(0) = 0
+ * 	and x(1) = 1. Trial solutions blow up in finite time unless v(0) is
+ * 	very close to the answer, so single shooting from the straight line
+ * 	guess overflows once mu is more than about 3. Multiple shooting with
+ * 	enough segments (20 for mu = 5) converges.
+ *
+ * The initial guess is the straight line between the boundary values. The
+ * Newton iterations and the solution are written to file.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <string>
+#include "statevector.h"
+#include "butcher.h"
+#include "bvp.h"
+
+typedef StateVector<2> Vector;
+
+/**
+ * Oscillator of question5.cpp, templated so it can be evaluated on dual
+ * numbers.
+ */
+struct Oscillator
+{
+	template <typename T>
+	StateVector<2, T> operator()(double t, const StateVector<2, T> & y) const
+	{
+		StateVector<2, T> temp;
+		temp[0] = -y[1];
+		temp[1] = y[0];
+		return temp;
+	}
+};
+
+/**
+ * Troesch's problem.
+ *
+ * double mu : strength of the nonlinearity.
+ */
+struct Troesch
+{
+	double mu;
+
+	template <typename T>
+	StateVector<2, T> operator()(double t, const StateVector<2, T> & y) const
+	{
+		using std::exp;
+		StateVector<2, T> temp;
+		temp[0] = 0.5 * mu * (exp(mu * y[1]) - exp(-mu * y[1]));
+		temp[1] = y[0];
+		return temp;
+	}
+};
+
+/**
+ * Boundary conditions x(a) = xa and x(b) = xb, leaving v free at both ends.
+ */
+struct Dirichlet
+{
+	double xa;
+	double xb;
+
+	template <typename T>
+	StateVector<2, T> operator()(const StateVector<2, T> & ya, const StateVector<2, T> & yb) const
+	{
+		StateVector<2, T> temp;
+		temp[0] = ya[1] - xa;
+		temp[1] = yb[1] - xb;
+		return temp;
+	}
+};
+
+/**
+ * Solve a problem with the given boundary values and write the results.
+ *
+ * std::string filename : output filename.
+ * F f : right hand side.
+ * Dirichlet g : boundary conditions.
+ * double a, b : ends of the interval.
+ * std::size_t segments : number of shooting segments.
+ * long long intervals : number of steps per segment.
+ * double tolerance : Newton tolerance.
+ */
+template <typename F>
+void Solve(std::string filename, F f, Dirichlet g, double a, double b, std::size_t segments, long long intervals, double tolerance);
+
+/**
+ * Main function, asks for the problem and the shooting parameters.
+ */
+int main()
+{
+	int problem;
+	printf("Please input problem (1 oscillator, 2 Troesch): ");
+	while (!(std::cin >> problem) || (problem != 1 && problem != 2))
+	{
+		printf("Enter valid problem: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	double finalT = 1;
+	Dirichlet g = {0, 1};
+	Troesch troesch = {5};
+
+	if (problem == 1)
+	{
+		printf("Please input goal time and x at the goal time: ");
+		std::cin >> finalT >> g.xb;
+	}
+	else
+	{
+		printf("Please input mu: ");
+		std::cin >> troesch.mu;
+	}
+
+	long long segments;
+	printf("Please input no. of shooting segments (1 for single shooting): ");
+	while (!(std::cin >> segments) || segments < 1)
+	{
+		printf("Enter valid no. of segments: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	long long intervals;
+	printf("Please input no. of intervals per segment: ");
+	while (!(std::cin >> intervals) || intervals < 1)
+	{
+		printf("Enter valid no. of intervals: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	double tolerance;
+	printf("Please input Newton tolerance: ");
+	std::cin >> tolerance;
+
+	if (problem == 1)
+		Solve("bvp_out", Oscillator(), g, 0, finalT, segments, intervals, tolerance);
+	else
+		Solve("bvp_out", troesch, g, 0, finalT, segments, intervals, tolerance);
+
+	printf("Done!\n");
+
+	return 0;
+}
+
+template <typename F>
+void Solve(std::string filename, F f, Dirichlet g, double a, double b, std::size_t segments, long long intervals, double tolerance)
+{
+	// Straight line guess, x from xa to xb with constant v.
+	std::vector<Vector> nodes(segments);
+	for (std::size_t m = 0; m != segments; m++)
+	{
+		double s = (double)m / segments;
+		nodes[m][0] = (g.xb - g.xa)/(b - a);
+		nodes[m][1] = g.xa + s * (g.xb - g.xa);
+	}
+
+	bool converged;
+	std::vector<NewtonIteration> history = MultipleShooting<2>(f, g, a, b, intervals, nodes, tolerance, 50, converged);
+
+	FILE * file = fopen(filename.c_str(), "w");
+
+	printf("Writing to file %s...\n", filename.c_str());
+
+	fprintf(file, "%-10s%-20s%-20s\n", "Iteration", "Residual", "Step");
+	for (std::size_t k = 0; k != history.size(); k++)
+	{
+		fprintf(file, "%-10lu%-20.12e%-20.12e\n", (unsigned long)(k + 1), history[k].residual, history[k].step);
+	}
+
+	if (converged)
+	{
+		// The solution, integrated from each node across its segment.
+		fprintf(file, "\n%-20s%-20s%-20s\n", "Time", "Result V", "Result X");
+		for (std::size_t m = 0; m != segments; m++)
+		{
+			double t0 = a + (b - a)*m/segments;
+			double h = (b - a)/segments/intervals;
+			Vector y = nodes[m];
+			for (long long i = 0; i != intervals; i++)
+			{
+				fprintf(file, "%-20.15f%-20.15f%-20.15f\n", t0 + i*h, y[0], y[1]);
+				y = ButcherStep<ClassicalFourth>(f, y, t0 + i*h, h);
+			}
+			if (m + 1 == segments)
+				fprintf(file, "%-20.15f%-20.15f%-20.15f\n", b, y[0], y[1]);
+		}
+
+		printf("Converged in %lu iterations, v(a) = %.15f\n", (unsigned long)history.size(), nodes[0][0]);
+	}
+	else
+	{
+		// An empty history means the first trial integration overflowed.
+		printf("Failed to converge after %lu iterations.\n", (unsigned long)history.size());
+	}
+
+	fclose(file);
+}
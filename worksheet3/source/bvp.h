@@ -0,0 +1,294 @@
+/**
+ * Two point boundary value problems by shooting and multiple shooting.
+ *
+ * The problem is y' = f(t, y) on [a, b], with N boundary conditions
+ * g(y(a), y(b)) = 0. Shooting treats the unknown initial state s as the root
+ * of the residual g(s, y(b; s)) and finds it by Newton's method, generalised
+ * from Newton_Raphson in worksheet1 to vectors.
+ *
+ * Multiple shooting splits [a, b] into M segments and takes the state at the
+ * start of each as unknown, adding the continuity of the solution at every
+ * segment boundary to the residual. Each segment is short, so errors in the
+ * guess grow far less before reaching its end than over the whole interval,
+ * and problems whose single shooting trajectories overflow can be solved.
+ * The segments are independent given the unknowns, so they are integrated in
+ * parallel.
+ *
+ * The Jacobian of the residual needs dy(t1)/ds for each segment, which obeys
+ * the variational equations Phi' = J Phi, Phi(t0) = I, with J = df/dy. These
+ * are integrated alongside the state by evaluating f once per stage on dual
+ * numbers, direction k seeded with column k of Phi (compare sensitivity.h).
+ * As the same steps are taken, Phi is the exact derivative of the discrete
+ * solution, so Newton's method converges quadratically.
+ */
+
+#ifndef BVP_H
+#define BVP_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "statevector.h"
+#include "butcher.h"
+#include "parallel.h"
+#include "linearalgebra.h"
+#include "../../common/dual.h"
+
+/**
+ * Progress of one Newton iteration.
+ *
+ * residual : largest component of the residual before the iteration.
+ * step : largest component of the Newton step.
+ */
+struct NewtonIteration
+{
+	double residual;
+	double step;
+};
+
+/**
+ * Newton's method for a system of n equations r(x) = 0. Stops when no
+ * component of the step is larger than tolerance, as Newton_Raphson.
+ *
+ * residual : called as residual(const std::vector<double> & x,
+ * 	std::vector<double> & r, std::vector<double> & J) to fill the residual
+ * 	and its n by n row major Jacobian. Returns false if r can't be
+ * 	evaluated at x.
+ * std::vector<double> & x : initial guess, updated to the root.
+ * double tolerance : largest step in any component at convergence.
+ * int maxIterations : most iterations to take.
+ * bool & converged : set to whether the tolerance was reached.
+ * return : residual and step of each iteration.
+ */
+template <typename R>
+std::vector<NewtonIteration> NewtonSolve(R residual, std::vector<double> & x, double tolerance, int maxIterations, bool & converged)
+{
+	int n = (int)x.size();
+	std::vector<double> r(n), J(n * n);
+	std::vector<int> pivot(n);
+	std::vector<NewtonIteration> history;
+
+	converged = false;
+
+	for (int k = 0; k != maxIterations; k++)
+	{
+		if (!residual(x, r, J))
+			break;
+
+		NewtonIteration iteration = {0, 0};
+		for (int i = 0; i != n; i++)
+			iteration.residual = std::max(iteration.residual, std::abs(r[i]));
+
+		if (!std::isfinite(iteration.residual) || LUDecompose(&J[0], n, &pivot[0]) != 0)
+		{
+			history.push_back(iteration);
+			break;
+		}
+
+		// Solve J dx = r and step to x - dx.
+		LUSolve(&J[0], n, &pivot[0], &r[0]);
+		for (int i = 0; i != n; i++)
+		{
+			x[i] -= r[i];
+			iteration.step = std::max(iteration.step, std::abs(r[i]));
+		}
+
+		history.push_back(iteration);
+
+		if (iteration.step < tolerance)
+		{
+			converged = true;
+			break;
+		}
+	}
+
+	return history;
+}
+
+/**
+ * Derivative of a state and its variational matrix Phi, held as y in
+ * components [0, N) and column k of Phi in [N (k + 1), N (k + 2)).
+ *
+ * F must accept a StateVector of Dual<double, N> as well as of double, as
+ * for AutomaticJacobian (see stiff.h).
+ */
+template <std::size_t N, typename F>
+class VariationalDerivative
+{
+public:
+	explicit VariationalDerivative(F f) :
+		f(f)
+	{
+	}
+
+	StateVector<N * (N + 1)> operator()(double t, const StateVector<N * (N + 1)> & y) const
+	{
+		StateVector<N, Dual<double, N> > in;
+		for (std::size_t i = 0; i != N; i++)
+		{
+			in[i] = Dual<double, N>(y[i]);
+			for (std::size_t k = 0; k != N; k++)
+				in[i].d[k] = y[N * (k + 1) + i];
+		}
+
+		StateVector<N, Dual<double, N> > out = f(t, in);
+
+		StateVector<N * (N + 1)> result;
+		for (std::size_t i = 0; i != N; i++)
+		{
+			result[i] = out[i].value;
+			for (std::size_t k = 0; k != N; k++)
+				result[N * (k + 1) + i] = out[i].d[k];
+		}
+		return result;
+	}
+
+private:
+	F f;
+};
+
+/**
+ * Integrate one segment with fourth order Runge-Kutta, with its variational
+ * equations.
+ *
+ * F f : right hand side, see VariationalDerivative.
+ * StateVector start : state at t0.
+ * double t0, t1 : ends of the segment.
+ * long long intervals : number of steps.
+ * StateVector & end : set to the state at t1.
+ * double Phi[] : filled with the N by N row major derivative of end with
+ * 	respect to start.
+ */
+template <std::size_t N, typename F>
+void ShootSegment(F f, const StateVector<N> & start, double t0, double t1, long long intervals, StateVector<N> & end, double Phi[])
+{
+	VariationalDerivative<N, F> d(f);
+
+	StateVector<N * (N + 1)> y;
+	for (std::size_t i = 0; i != N * (N + 1); i++)
+		y[i] = 0;
+	for (std::size_t i = 0; i != N; i++)
+	{
+		y[i] = start[i];
+		y[N * (i + 1) + i] = 1;
+	}
+
+	double h = (t1 - t0)/intervals;
+	double t = t0;
+	for (long long i = 0; i != intervals; i++)
+	{
+		y = ButcherStep<ClassicalFourth>(d, y, t, h);
+		t = t0 + (i + 1)*h;
+	}
+
+	for (std::size_t i = 0; i != N; i++)
+	{
+		end[i] = y[i];
+		for (std::size_t k = 0; k != N; k++)
+			Phi[i*N + k] = y[N * (k + 1) + i];
+	}
+}
+
+/**
+ * Solve a boundary value problem by multiple shooting, or single shooting
+ * with one segment.
+ *
+ * F f : right hand side, see VariationalDerivative.
+ * G g : boundary conditions, called as g(const StateVector<N, T> & ya,
+ * 	const StateVector<N, T> & yb) with T double or Dual<double, 2 N>, and
+ * 	returning the N residuals as a StateVector<N, T>.
+ * double a, b : ends of the interval.
+ * long long intervals : number of steps per segment.
+ * std::vector<StateVector> & nodes : guesses of the state at the start of
+ * 	each of the equal segments, updated to the solution.
+ * double tolerance : largest Newton step in any component at convergence.
+ * int maxIterations : most Newton iterations.
+ * bool & converged : set to whether the tolerance was reached.
+ * return : residual and step of each Newton iteration, empty if there are
+ * 	no nodes or intervals is less than 1.
+ */
+template <std::size_t N, typename F, typename G>
+std::vector<NewtonIteration> MultipleShooting(F f, G g, double a, double b, long long intervals, std::vector<StateVector<N> > & nodes, double tolerance, int maxIterations, bool & converged)
+{
+	converged = false;
+	if (nodes.empty() || intervals < 1)
+		return std::vector<NewtonIteration>();
+
+	std::size_t M = nodes.size();
+	std::size_t n = M * N;
+
+	std::vector<StateVector<N> > ends(M);
+	std::vector<double> Phi(M * N * N);
+
+	auto residual = [&](const std::vector<double> & x, std::vector<double> & r, std::vector<double> & J)
+	{
+		for (std::size_t m = 0; m != M; m++)
+			for (std::size_t i = 0; i != N; i++)
+				nodes[m][i] = x[m*N + i];
+
+		ParallelFor(M, [&](unsigned worker, std::size_t begin, std::size_t end)
+		{
+			for (std::size_t m = begin; m != end; m++)
+				ShootSegment(f, nodes[m], a + (b - a)*m/M, a + (b - a)*(m + 1)/M, intervals, ends[m], &Phi[m * N * N]);
+		});
+
+		std::fill(J.begin(), J.end(), 0.0);
+
+		// Continuity, y(t_{m+1}; s_m) - s_{m+1}.
+		for (std::size_t m = 0; m + 1 < M; m++)
+		{
+			for (std::size_t i = 0; i != N; i++)
+			{
+				std::size_t row = m*N + i;
+				r[row] = ends[m][i] - nodes[m + 1][i];
+				for (std::size_t k = 0; k != N; k++)
+					J[row*n + m*N + k] = Phi[(m*N + i)*N + k];
+				J[row*n + (m + 1)*N + i] = -1;
+			}
+		}
+
+		// Boundary conditions on duals, seeded with y(a) then y(b).
+		StateVector<N, Dual<double, 2 * N> > ya, yb;
+		for (std::size_t i = 0; i != N; i++)
+		{
+			ya[i] = Dual<double, 2 * N>(nodes[0][i], i);
+			yb[i] = Dual<double, 2 * N>(ends[M - 1][i], N + i);
+		}
+		StateVector<N, Dual<double, 2 * N> > bc = g(ya, yb);
+
+		const double * last = &Phi[(M - 1) * N * N];
+		for (std::size_t i = 0; i != N; i++)
+		{
+			std::size_t row = (M - 1)*N + i;
+			r[row] = bc[i].value;
+			for (std::size_t k = 0; k != N; k++)
+			{
+				// dg/dy(a) on the first node, dg/dy(b) Phi on the last.
+				J[row*n + k] += bc[i].d[k];
+				for (std::size_t j = 0; j != N; j++)
+					J[row*n + (M - 1)*N + k] += bc[i].d[N + j] * last[j*N + k];
+			}
+		}
+
+		for (std::size_t i = 0; i != n; i++)
+			if (!std::isfinite(r[i]))
+				return false;
+		return true;
+	};
+
+	std::vector<double> x(n);
+	for (std::size_t m = 0; m != M; m++)
+		for (std::size_t i = 0; i != N; i++)
+			x[m*N + i] = nodes[m][i];
+
+	std::vector<NewtonIteration> history = NewtonSolve(residual, x, tolerance, maxIterations, converged);
+
+	for (std::size_t m = 0; m != M; m++)
+		for (std::size_t i = 0; i != N; i++)
+			nodes[m][i] = x[m*N + i];
+
+	return history;
+}
+
+#endif
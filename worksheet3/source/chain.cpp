@@ -0,0 +1,190 @@
+/**
+ * Source code for a program which integrates a large chain or square
+ * lattice of coupled oscillators (see largesystem.h), comparing fused single
+ * pass steps against the usual one pass per operation step.
+ *
+ * The masses start at rest, displaced in a Gaussian pulse about the middle
+ * of the chain (or lattice), which then spreads out as waves. The time per
+ * step, the memory traffic per second and the energy error of each method
+ * are written to file.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include "parallel.h"
+#include "largesystem.h"
+
+/**
+ * Result of one method.
+ *
+ * seconds : run time of all steps.
+ * traffic : bytes read and written per step, counting each array streamed
+ * 	once.
+ * energyError : relative change in energy over the run.
+ */
+struct ChainResult
+{
+	double seconds;
+	double traffic;
+	double energyError;
+};
+
+/**
+ * InitialPulse displaces the masses in a Gaussian pulse, width a twentieth
+ * of the system, about the middle, with all masses at rest.
+ *
+ * LargeState & state : state to set.
+ * std::size_t width : masses per row (the size of a chain).
+ * std::size_t height : number of rows, 1 for a chain.
+ */
+void InitialPulse(LargeState & state, std::size_t width, std::size_t height);
+
+/**
+ * Integrate a system with each method from the same initial state, write the
+ * results to file and print them.
+ *
+ * std::string filename : output filename.
+ * const System & system : chain or lattice.
+ * std::size_t width, height : shape of the system, height 1 for a chain.
+ * long long intervals : number of steps.
+ * double h : width of step.
+ */
+template <typename System>
+void Compare(std::string filename, const System & system, std::size_t width, std::size_t height, long long intervals, double h);
+
+/**
+ * Main function, asks for the system and integration parameters.
+ */
+int main()
+{
+	int shape;
+	printf("Please input system (1 chain, 2 square lattice): ");
+	while (!(std::cin >> shape) || (shape != 1 && shape != 2))
+	{
+		printf("Enter valid system: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	std::size_t size;
+	printf(shape == 1 ? "Please input no. of masses: " : "Please input no. of masses per side: ");
+	std::cin >> size;
+
+	long long intervals;
+	printf("Please input no. of intervals: ");
+	std::cin >> intervals;
+
+	double h;
+	printf("Please input step width: ");
+	std::cin >> h;
+
+	if (shape == 1)
+	{
+		OscillatorChain chain = {size, 1.0, 100.0};
+		Compare("chain_out", chain, size, 1, intervals, h);
+	}
+	else
+	{
+		OscillatorLattice lattice = {size, size, 1.0, 100.0};
+		Compare("chain_out", lattice, size, size, intervals, h);
+	}
+
+	printf("Done!\n");
+
+	return 0;
+}
+
+void InitialPulse(LargeState & state, std::size_t width, std::size_t height)
+{
+	double spread = std::max(1.0, width/20.0);
+
+	for (std::size_t r = 0; r != height; r++)
+	{
+		for (std::size_t c = 0; c != width; c++)
+		{
+			double dx = (c - 0.5*width)/spread;
+			double dy = height > 1 ? (r - 0.5*height)/spread : 0;
+			state.x[r * width + c] = std::exp(-(dx*dx + dy*dy));
+		}
+	}
+}
+
+template <typename System>
+void Compare(std::string filename, const System & system, std::size_t width, std::size_t height, long long intervals, double h)
+{
+	std::size_t size = width * height;
+	ThreadTeam team;
+
+	printf("%lu masses, %u threads.\n", (unsigned long)size, team.Size());
+
+	LargeState initial(size);
+	InitialPulse(initial, width, height);
+	double energy = system.Energy(initial);
+
+	LargeIntegrator<System> integrator(system, team, size);
+
+	const char * names[3] = {"Midpoint (fused)", "Midpoint", "Verlet (fused)"};
+	// Arrays streamed per step: the fused steps read and write x and v (and
+	// a for Verlet), the unfused step streams 15 arrays over four passes.
+	double arrays[3] = {4, 15, 6};
+	ChainResult results[3];
+	// Positions reached by the fused midpoint step, to check the unfused
+	// step against.
+	std::vector<double> fusedX;
+	double difference = 0;
+
+	for (int m = 0; m != 3; m++)
+	{
+		LargeState state = initial;
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (m == 2)
+			integrator.PrepareVerlet(state);
+
+		for (long long i = 0; i != intervals; i++)
+		{
+			if (m == 0)
+				integrator.MidpointStep(state, h);
+			else if (m == 1)
+				integrator.UnfusedMidpointStep(state, h);
+			else
+				integrator.VerletStep(state, h);
+		}
+
+		results[m].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		results[m].traffic = arrays[m] * size * sizeof(double);
+		results[m].energyError = std::abs((system.Energy(state) - energy)/energy);
+
+		// The fused and unfused midpoint steps do the same arithmetic.
+		if (m == 0)
+			fusedX = state.x;
+		else if (m == 1)
+			for (std::size_t i = 0; i != size; i++)
+				difference = std::max(difference, std::abs(fusedX[i] - state.x[i]));
+	}
+
+	FILE * file = fopen(filename.c_str(), "w");
+
+	printf("Writing to file %s...\n", filename.c_str());
+
+	fprintf(file, "%-20s%-20s%-20s%-20s%-20s\n", "Method", "Time", "Step Time", "Bandwidth (GB/s)", "Energy Error");
+
+	for (int m = 0; m != 3; m++)
+	{
+		double step = results[m].seconds / intervals;
+		double bandwidth = results[m].traffic / step / 1e9;
+
+		fprintf(file, "%-20s%-20.6f%-20.9f%-20.3f%-20.3e\n", names[m], results[m].seconds, step, bandwidth, results[m].energyError);
+		printf("%-20s%10.6f s per step, %8.3f GB/s, energy error %.3e\n", names[m], step, bandwidth, results[m].energyError);
+	}
+
+	fclose(file);
+
+	printf("Largest difference between fused and unfused midpoint: %.3e\n", difference);
+}
@@ -0,0 +1,275 @@
+/**
+ * Cache of trajectory checkpoints, so that a long time query can continue
+ * from where an earlier query got to instead of integrating again from the
+ * initial conditions.
+ *
+ * A trajectory is identified by a key built from the system, the method, its
+ * step width or tolerance and the initial conditions (see CheckpointKey). For
+ * each key the cache holds the state at a set of checkpoint times. A query for
+ * time t resumes from the latest checkpoint at or before t, so a run to time
+ * T followed by one to T + dT only costs the integration over dT.
+ *
+ * Checkpoints are only taken at step boundaries of the method's own step
+ * sequence, never at a step shortened to land on a goal time, so a resumed
+ * trajectory takes the same steps as an uninterrupted one.
+ *
+ * The number of checkpoints per trajectory is capped, which keeps the cache
+ * file small enough to rewrite whole. Over the cap, a trajectory is thinned
+ * so that the spacing of its checkpoints grows geometrically back from the
+ * latest one: a query resumes at most a fixed fraction of its distance back
+ * from the latest checkpoint, from the nearest checkpoint before it. The
+ * first and latest checkpoints are always kept.
+ *
+ * The cache can be written to and read from a text file, so it persists
+ * across runs of a program as well as across queries within one run.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "statevector.h"
+
+/**
+ * State of a trajectory at a step boundary.
+ *
+ * t : time.
+ * y : state at t.
+ * h : width of the next step (the proposed width for adaptive methods).
+ * steps : number of steps taken from the initial conditions.
+ */
+template <std::size_t N, typename T = double>
+struct Checkpoint
+{
+	double t;
+	StateVector<N, T> y;
+	double h;
+	long long steps;
+};
+
+/**
+ * Build the key of a trajectory. Numbers are written with 17 significant
+ * figures so that different doubles never share a key.
+ *
+ * std::string system : name of the system of ODEs.
+ * std::string method : name of the integration method.
+ * double parameter : step width or tolerance of the method.
+ * double startT : start time for the initial conditions.
+ * StateVector startY : initial conditions.
+ * return : key, containing no whitespace.
+ */
+template <std::size_t N, typename T>
+std::string CheckpointKey(std::string system, std::string method, double parameter, double startT, const StateVector<N, T> & startY)
+{
+	char buffer[32];
+	std::string key = system + "/" + method;
+
+	snprintf(buffer, sizeof(buffer), "/%.17g", parameter);
+	key += buffer;
+	snprintf(buffer, sizeof(buffer), "/%.17g", startT);
+	key += buffer;
+	for (std::size_t i = 0; i != N; i++)
+	{
+		snprintf(buffer, sizeof(buffer), "%c%.17g", i == 0 ? '/' : ',', (double)startY[i]);
+		key += buffer;
+	}
+
+	return key;
+}
+
+/**
+ * Checkpoints of any number of trajectories of a system of dimension N.
+ */
+template <std::size_t N, typename T = double>
+class TrajectoryCache
+{
+public:
+	/**
+	 * std::size_t capacity : most checkpoints held per trajectory, at
+	 * 	least two.
+	 */
+	explicit TrajectoryCache(std::size_t capacity = 64) :
+		capacity(std::max<std::size_t>(2, capacity)), modified(false)
+	{}
+
+	/**
+	 * Latest checkpoint of a trajectory at or before time t, in the
+	 * direction of integration.
+	 *
+	 * std::string key : trajectory key.
+	 * double t : time wanted.
+	 * const Checkpoint * & found : set to the checkpoint, or 0 if none.
+	 * return : whether a checkpoint was found.
+	 */
+	bool Nearest(const std::string & key, double t, const Checkpoint<N, T> * & found) const
+	{
+		found = 0;
+
+		typename Store::const_iterator it = store.find(key);
+		if (it == store.end())
+			return false;
+
+		// Checkpoints are kept sorted along the direction of integration,
+		// which is the sign of h.
+		const std::vector<Checkpoint<N, T> > & list = it->second;
+		if (list.empty())
+			return false;
+
+		double direction = list.front().h < 0 ? -1 : 1;
+		typename std::vector<Checkpoint<N, T> >::const_iterator after = std::upper_bound(list.begin(), list.end(), t,
+			[direction](double t, const Checkpoint<N, T> & checkpoint) { return (checkpoint.t - t) * direction > 0; });
+
+		if (after == list.begin())
+			return false;
+
+		found = &*(after - 1);
+		return true;
+	}
+
+	/**
+	 * Add a checkpoint to a trajectory. Checkpoints at or before the last
+	 * one held are ignored, as they add nothing. Thins the trajectory if it
+	 * is over capacity.
+	 */
+	void Add(const std::string & key, const Checkpoint<N, T> & checkpoint)
+	{
+		std::vector<Checkpoint<N, T> > & list = store[key];
+		if (!list.empty() && checkpoint.steps <= list.back().steps)
+			return;
+		list.push_back(checkpoint);
+		modified = true;
+
+		if (list.size() > capacity)
+			Thin(list);
+	}
+
+	// Number of checkpoints held for a trajectory.
+	std::size_t Count(const std::string & key) const
+	{
+		typename Store::const_iterator it = store.find(key);
+		return it == store.end() ? 0 : it->second.size();
+	}
+
+	/**
+	 * Read checkpoints from file, adding them to the cache. A missing file
+	 * is not an error, it just means nothing has been cached yet.
+	 *
+	 * std::string filename : cache filename.
+	 * return : number of checkpoints read.
+	 */
+	std::size_t Load(std::string filename)
+	{
+		FILE * file = fopen(filename.c_str(), "r");
+		if (file == 0)
+			return 0;
+
+		std::size_t count = 0;
+		char key[1024];
+		Checkpoint<N, T> checkpoint;
+
+		while (fscanf(file, "%1023s %lf %lf %lli", key, &checkpoint.t, &checkpoint.h, &checkpoint.steps) == 4)
+		{
+			bool complete = true;
+			for (std::size_t i = 0; i != N && complete; i++)
+			{
+				double value;
+				complete = fscanf(file, "%lf", &value) == 1;
+				checkpoint.y[i] = value;
+			}
+			if (!complete)
+				break;
+
+			Add(key, checkpoint);
+			count++;
+		}
+
+		fclose(file);
+		modified = false;
+
+		return count;
+	}
+
+	/**
+	 * Write every checkpoint to file, one per line, if anything was added
+	 * since the last Load or Save.
+	 *
+	 * std::string filename : cache filename.
+	 */
+	void Save(std::string filename)
+	{
+		if (!modified)
+			return;
+
+		FILE * file = fopen(filename.c_str(), "w");
+		if (file == 0)
+		{
+			printf("Unable to write cache file %s.\n", filename.c_str());
+			return;
+		}
+
+		for (typename Store::const_iterator it = store.begin(); it != store.end(); ++it)
+		{
+			for (std::size_t i = 0; i != it->second.size(); i++)
+			{
+				const Checkpoint<N, T> & checkpoint = it->second[i];
+				fprintf(file, "%s %.17g %.17g %lli", it->first.c_str(), checkpoint.t, checkpoint.h, checkpoint.steps);
+				for (std::size_t j = 0; j != N; j++)
+					fprintf(file, " %.17g", (double)checkpoint.y[j]);
+				fprintf(file, "\n");
+			}
+		}
+
+		fclose(file);
+		modified = false;
+	}
+
+private:
+	/**
+	 * Thin a trajectory, walking back from the latest checkpoint and
+	 * keeping one if it is at least 1 / density of its distance from the
+	 * latest away from the last one kept. The density is halved until
+	 * three quarters of the capacity or fewer are kept, leaving room for
+	 * new checkpoints before the next thinning. Even at density 1 the
+	 * latest, the one before it and the first are kept, so with a smaller
+	 * capacity the oldest kept checkpoints after the first are dropped.
+	 */
+	void Thin(std::vector<Checkpoint<N, T> > & list) const
+	{
+		const Checkpoint<N, T> & latest = list.back();
+		std::vector<Checkpoint<N, T> > kept;
+
+		for (long long density = capacity / 2; ; density = std::max(1LL, density / 2))
+		{
+			kept.assign(1, latest);
+			for (std::size_t i = list.size() - 2; i > 0; i--)
+			{
+				long long distance = latest.steps - list[i].steps;
+				if (kept.back().steps - list[i].steps >= distance / density)
+					kept.push_back(list[i]);
+			}
+			kept.push_back(list.front());
+
+			if (kept.size() <= capacity * 3 / 4 || density == 1)
+				break;
+		}
+
+		// Newest first, so the first checkpoint is at the back.
+		while (kept.size() > capacity)
+			kept.erase(kept.end() - 2);
+
+		list.assign(kept.rbegin(), kept.rend());
+	}
+
+	typedef std::map<std::string, std::vector<Checkpoint<N, T> > > Store;
+
+	Store store;
+	std::size_t capacity;
+	bool modified;
+};
+
+#endif
@@ -0,0 +1,415 @@
+/**
+ * Lossless compression of columns of doubles, in the style of Gorilla
+ * (Pelkonen et al., "Gorilla: A Fast, Scalable, In-Memory Time Series
+ * Database").
+ *
+ * Trajectory columns are very regular. Time advances by an almost constant
+ * step, so the difference between successive differences of its bit
+ * pattern is usually zero or tiny: DeltaEncoder stores that
+ * delta-of-delta in a variable number of bits, one bit when it is zero.
+ * State columns change smoothly, so a value is close to the linear
+ * extrapolation of the two before it: XorEncoder stores the XOR of the
+ * value's bit pattern with that prediction. Close doubles share their sign,
+ * exponent and leading mantissa bits, so the XOR has long runs of leading
+ * (and often trailing) zeros and only the bits between are written.
+ *
+ * Encoders and decoders are streaming: values go in and come out one at a
+ * time, in order, and each holds only the last few values. The decoder
+ * repeats the encoder's prediction in double arithmetic, so both must be
+ * compiled for the same floating point (SSE2, as on x86-64, not x87).
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+/**
+ * Bit pattern of a double.
+ */
+inline unsigned long long DoubleBits(double x)
+{
+	unsigned long long bits;
+	memcpy(&bits, &x, sizeof(bits));
+	return bits;
+}
+
+/**
+ * Double with a bit pattern.
+ */
+inline double BitsDouble(unsigned long long bits)
+{
+	double x;
+	memcpy(&x, &bits, sizeof(x));
+	return x;
+}
+
+/**
+ * Appends bits to a byte array, most significant bit first.
+ */
+class BitWriter
+{
+public:
+	/**
+	 * std::vector<unsigned char> & bytes : array appended to.
+	 */
+	explicit BitWriter(std::vector<unsigned char> & bytes) :
+		bytes(bytes), current(0), count(0)
+	{
+	}
+
+	/**
+	 * Append the low bits of a value.
+	 *
+	 * unsigned long long value : value.
+	 * int bits : number of bits, 0 to 64.
+	 */
+	void Write(unsigned long long value, int bits)
+	{
+		while (bits > 0)
+		{
+			int take = bits < 8 - count ? bits : 8 - count;
+			bits -= take;
+			current = (current << take) | (unsigned)((value >> bits) & ((1u << take) - 1));
+			count += take;
+
+			if (count == 8)
+			{
+				bytes.push_back((unsigned char)current);
+				current = 0;
+				count = 0;
+			}
+		}
+	}
+
+	/**
+	 * Pad the last byte with zeros and append it.
+	 */
+	void Flush()
+	{
+		if (count > 0)
+			Write(0, 8 - count);
+	}
+
+private:
+	std::vector<unsigned char> & bytes;
+	unsigned current;
+	int count;
+};
+
+/**
+ * Reads bits written by BitWriter. Reading past the end gives zeros.
+ */
+class BitReader
+{
+public:
+	/**
+	 * const unsigned char * data : bytes to read.
+	 * std::size_t size : number of bytes.
+	 */
+	BitReader(const unsigned char * data, std::size_t size) :
+		data(data), size(size), position(0), count(0)
+	{
+	}
+
+	/**
+	 * Read a value.
+	 *
+	 * int bits : number of bits, 0 to 64.
+	 */
+	unsigned long long Read(int bits)
+	{
+		unsigned long long value = 0;
+
+		while (bits > 0)
+		{
+			unsigned byte = position < size ? data[position] : 0;
+			int take = bits < 8 - count ? bits : 8 - count;
+			value = (value << take) | ((byte >> (8 - count - take)) & ((1u << take) - 1));
+			bits -= take;
+			count += take;
+
+			if (count == 8)
+			{
+				position++;
+				count = 0;
+			}
+		}
+
+		return value;
+	}
+
+private:
+	const unsigned char * data;
+	std::size_t size;
+	// Current byte and bits of it already read.
+	std::size_t position;
+	int count;
+};
+
+/**
+ * Encodes a column of steadily increasing values, such as time, as the
+ * delta-of-delta of their bit patterns.
+ *
+ * A delta-of-delta d is written as
+ * 	0 if d = 0,
+ * 	10 and 7 bits if -64 <= d < 64,
+ * 	110 and 9 bits if -256 <= d < 256,
+ * 	1110 and 12 bits if -2048 <= d < 2048,
+ * 	1111 and 64 bits otherwise.
+ * The first value is written in full.
+ */
+class DeltaEncoder
+{
+public:
+	DeltaEncoder() :
+		previous(0), delta(0), count(0)
+	{
+	}
+
+	void Encode(BitWriter & out, double x)
+	{
+		unsigned long long bits = DoubleBits(x);
+
+		if (count == 0)
+		{
+			out.Write(bits, 64);
+		}
+		else
+		{
+			// Unsigned arithmetic wraps, and the decoder wraps the same way.
+			unsigned long long d = bits - previous;
+			long long dod = (long long)(d - delta);
+			delta = d;
+
+			if (dod == 0)
+			{
+				out.Write(0, 1);
+			}
+			else if (dod >= -64 && dod < 64)
+			{
+				out.Write(2, 2);
+				out.Write(dod, 7);
+			}
+			else if (dod >= -256 && dod < 256)
+			{
+				out.Write(6, 3);
+				out.Write(dod, 9);
+			}
+			else if (dod >= -2048 && dod < 2048)
+			{
+				out.Write(14, 4);
+				out.Write(dod, 12);
+			}
+			else
+			{
+				out.Write(15, 4);
+				out.Write(dod, 64);
+			}
+		}
+
+		previous = bits;
+		count++;
+	}
+
+private:
+	unsigned long long previous;
+	unsigned long long delta;
+	long long count;
+};
+
+/**
+ * Decodes values written by DeltaEncoder.
+ */
+class DeltaDecoder
+{
+public:
+	DeltaDecoder() :
+		previous(0), delta(0), count(0)
+	{
+	}
+
+	double Decode(BitReader & in)
+	{
+		if (count++ == 0)
+		{
+			previous = in.Read(64);
+			return BitsDouble(previous);
+		}
+
+		unsigned long long dod;
+		if (in.Read(1) == 0)
+			dod = 0;
+		else if (in.Read(1) == 0)
+			dod = SignExtend(in.Read(7), 7);
+		else if (in.Read(1) == 0)
+			dod = SignExtend(in.Read(9), 9);
+		else if (in.Read(1) == 0)
+			dod = SignExtend(in.Read(12), 12);
+		else
+			dod = in.Read(64);
+
+		delta += dod;
+		previous += delta;
+		return BitsDouble(previous);
+	}
+
+private:
+	unsigned long long previous;
+	unsigned long long delta;
+	long long count;
+
+	static unsigned long long SignExtend(unsigned long long value, int bits)
+	{
+		unsigned long long sign = 1ull << (bits - 1);
+		return (value ^ sign) - sign;
+	}
+};
+
+/**
+ * Predicts the next value of a smoothly changing column: the linear
+ * extrapolation of the last two values, or the last value at the start.
+ */
+class LinearPredictor
+{
+public:
+	LinearPredictor() :
+		count(0)
+	{
+		last[0] = last[1] = 0;
+	}
+
+	double Predict() const
+	{
+		if (count < 2)
+			return last[1];
+		return 2 * last[1] - last[0];
+	}
+
+	void Update(double x)
+	{
+		last[0] = last[1];
+		last[1] = x;
+		count++;
+	}
+
+private:
+	double last[2];
+	int count;
+};
+
+/**
+ * Encodes a column of smoothly changing values as the XOR of each value's
+ * bit pattern with its prediction (see LinearPredictor).
+ *
+ * Each XOR x is written as
+ * 	0 if x = 0,
+ * 	10 and the bits of x within the previous window of meaningful bits, if
+ * 	they hold all of its set bits and no more than 11 other bits,
+ * 	11, 5 bits of leading zeros, 6 bits of window length (0 for 64) and the
+ * 	bits of x within the new window, otherwise.
+ */
+class XorEncoder
+{
+public:
+	XorEncoder() :
+		leading(-1), trailing(0)
+	{
+	}
+
+	void Encode(BitWriter & out, double x)
+	{
+		unsigned long long bits = DoubleBits(x) ^ DoubleBits(predictor.Predict());
+		predictor.Update(x);
+
+		if (bits == 0)
+		{
+			out.Write(0, 1);
+			return;
+		}
+
+		int lz = __builtin_clzll(bits);
+		int tz = __builtin_ctzll(bits);
+		// Leading zeros are written in 5 bits.
+		if (lz > 31)
+			lz = 31;
+
+		// Reuse the previous window if it holds the set bits and wastes
+		// fewer bits than a new window header would cost.
+		if (leading >= 0 && lz >= leading && tz >= trailing && (lz - leading) + (tz - trailing) <= 11)
+		{
+			out.Write(2, 2);
+			out.Write(bits >> trailing, 64 - leading - trailing);
+		}
+		else
+		{
+			leading = lz;
+			trailing = tz;
+			out.Write(3, 2);
+			out.Write(leading, 5);
+			out.Write((64 - leading - trailing) & 63, 6);
+			out.Write(bits >> trailing, 64 - leading - trailing);
+		}
+	}
+
+private:
+	LinearPredictor predictor;
+	// Window of meaningful bits of the last XOR written with one, -1 before
+	// the first.
+	int leading;
+	int trailing;
+};
+
+/**
+ * Decodes values written by XorEncoder.
+ */
+class XorDecoder
+{
+public:
+	// Set if a window ran past the 64 bits of a value, which only a corrupt
+	// block gives. The value is then NaN.
+	bool corrupt;
+
+	XorDecoder() :
+		corrupt(false), leading(0), trailing(0)
+	{
+	}
+
+	double Decode(BitReader & in)
+	{
+		unsigned long long bits = 0;
+
+		if (in.Read(1) == 1)
+		{
+			if (in.Read(1) == 1)
+			{
+				int lz = (int)in.Read(5);
+				int length = (int)in.Read(6);
+				if (length == 0)
+					length = 64;
+				if (lz + length > 64)
+				{
+					corrupt = true;
+					return std::numeric_limits<double>::quiet_NaN();
+				}
+				leading = lz;
+				trailing = 64 - leading - length;
+			}
+			bits = in.Read(64 - leading - trailing) << trailing;
+		}
+
+		double x = BitsDouble(bits ^ DoubleBits(predictor.Predict()));
+		predictor.Update(x);
+		return x;
+	}
+
+private:
+	LinearPredictor predictor;
+	int leading;
+	int trailing;
+};
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * Output decimation for very long trajectories, applied as the solver runs.
+ *
+ * Writing every one of 10^8 steps produces gigabytes which are then thinned
+ * out by hand. A Decimator is offered every step and decides which to write,
+ * by one of these policies:
+ *
+ * 	KeepAll : every step.
+ * 	KeepEvery : every k-th step.
+ * 	KeepOnChange : a step whose state differs by more than epsilon (in any
+ * 	component) from the straight line through the last two written
+ * 	steps. Extrapolating from the written steps in the same way therefore
+ * 	recovers every unwritten step to within epsilon, while smooth stretches
+ * 	of the trajectory cost almost nothing.
+ * 	KeepReservoir : a uniform random sample of fixed size from all steps
+ * 	(Vitter's algorithm R), written in order at the end, followed by the
+ * 	last step unless it was drawn. Random numbers come from a
+ * 	counter-based generator (see random.h), so the sample is reproducible.
+ *
+ * Memory use is constant: a few states for the streaming policies, and the
+ * sample itself for the reservoir. The last step is always written, so the
+ * end of the trajectory is kept.
+ */
+
+#ifndef DECIMATION_H
+#define DECIMATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "statevector.h"
+#include "random.h"
+
+enum DecimationPolicy {KeepAll, KeepEvery, KeepOnChange, KeepReservoir};
+
+/**
+ * Decimator for rows of type Row, describing states of dimension N.
+ */
+template <std::size_t N, typename Row>
+class Decimator
+{
+public:
+	/**
+	 * DecimationPolicy policy : which steps to write.
+	 * double parameter : k for KeepEvery, epsilon for KeepOnChange, size of
+	 * 	the sample for KeepReservoir, unused for KeepAll.
+	 * std::uint64_t seed : key of the random numbers for KeepReservoir.
+	 */
+	Decimator(DecimationPolicy policy, double parameter, std::uint64_t seed = 0) :
+		offered(0), written(0), policy(policy),
+		// Counts are whole and at least one.
+		parameter(policy == KeepEvery || policy == KeepReservoir ? std::max(1.0, std::floor(parameter)) : parameter),
+		random(seed), anchors(0), pending(false)
+	{
+	}
+
+	/**
+	 * Offer a step, calling write(const Row &) for each row to write.
+	 *
+	 * double t : time of the step.
+	 * StateVector y : state, compared by KeepOnChange.
+	 * const Row & row : row to write.
+	 * Write write : writes a row.
+	 */
+	template <typename Write>
+	void Offer(double t, const StateVector<N> & y, const Row & row, Write write)
+	{
+		bool keep = false;
+
+		switch (policy)
+		{
+			case KeepAll:
+				keep = true;
+				break;
+			case KeepEvery:
+				keep = offered % (long long)parameter == 0;
+				break;
+			case KeepOnChange:
+				keep = Departs(t, y);
+				break;
+			case KeepReservoir:
+				Sample(row);
+				break;
+		}
+
+		offered++;
+
+		if (keep)
+		{
+			Emit(t, y, row, write);
+		}
+		else
+		{
+			// Held in case it is the last step.
+			last = row;
+			lastT = t;
+			lastY = y;
+			pending = true;
+		}
+	}
+
+	/**
+	 * Write whatever remains once the trajectory is finished: the reservoir
+	 * sample in order, then the last step if it wasn't written.
+	 */
+	template <typename Write>
+	void Finish(Write write)
+	{
+		if (policy == KeepReservoir)
+		{
+			std::sort(reservoir.begin(), reservoir.end(),
+				[](const Sampled & a, const Sampled & b) { return a.index < b.index; });
+
+			// The last step may have been drawn, ending the sample already.
+			if (!reservoir.empty() && reservoir.back().index == offered - 1)
+				pending = false;
+
+			for (std::size_t i = 0; i != reservoir.size(); i++)
+				write(reservoir[i].row);
+			written += reservoir.size();
+			reservoir.clear();
+		}
+
+		if (pending)
+		{
+			Emit(lastT, lastY, last, write);
+		}
+	}
+
+	// Number of steps offered and rows written.
+	long long offered;
+	long long written;
+
+private:
+	// A step in the reservoir, with its position in the trajectory.
+	struct Sampled
+	{
+		long long index;
+		Row row;
+	};
+
+	DecimationPolicy policy;
+	double parameter;
+	Philox random;
+
+	// Last two written steps, anchors of them valid, newest in [1].
+	double anchorT[2];
+	StateVector<N> anchorY[2];
+	int anchors;
+
+	// Last step offered, if not written.
+	bool pending;
+	Row last;
+	double lastT;
+	StateVector<N> lastY;
+
+	std::vector<Sampled> reservoir;
+
+	template <typename Write>
+	void Emit(double t, const StateVector<N> & y, const Row & row, Write write)
+	{
+		write(row);
+		written++;
+		pending = false;
+
+		anchorT[0] = anchorT[1];
+		anchorY[0] = anchorY[1];
+		anchorT[1] = t;
+		anchorY[1] = y;
+		anchors = std::min(anchors + 1, 2);
+	}
+
+	/**
+	 * Whether y at t is further than epsilon from the extrapolation of the
+	 * written steps: the line through the last two, or the last one alone
+	 * if there is one or both are at the same time.
+	 */
+	bool Departs(double t, const StateVector<N> & y) const
+	{
+		if (anchors == 0)
+			return true;
+
+		double theta = 0;
+		if (anchors == 2 && anchorT[1] != anchorT[0])
+			theta = (t - anchorT[1]) / (anchorT[1] - anchorT[0]);
+
+		for (std::size_t i = 0; i != N; i++)
+		{
+			double predicted = anchorY[1][i] + theta * (anchorY[1][i] - anchorY[0][i]);
+			if (std::abs(y[i] - predicted) > parameter)
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Algorithm R: the first k steps fill the reservoir, then step n
+	 * replaces a uniformly chosen entry with probability k / (n + 1).
+	 */
+	void Sample(const Row & row)
+	{
+		std::size_t size = (std::size_t)parameter;
+		Sampled sampled = {offered, row};
+
+		if (reservoir.size() < size)
+		{
+			reservoir.push_back(sampled);
+			return;
+		}
+
+		std::uint32_t counter[4] = {(std::uint32_t)offered, (std::uint32_t)(offered >> 32), 0, 0};
+		std::uint32_t bits[4];
+		random(counter, bits);
+		std::uint64_t j = ((std::uint64_t)bits[0] << 32 | bits[1]) % (std::uint64_t)(offered + 1);
+
+		if (j < size)
+			reservoir[j] = sampled;
+	}
+};
+
+#endif
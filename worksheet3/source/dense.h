@@ -0,0 +1,96 @@
+/**
+ * Dense output: sampling the solution of an ODE between step boundaries.
+ *
+ * A step from (t0, y0) to (t1, y1) where the derivatives f0 and f1 are known
+ * at both ends determines a cubic Hermite polynomial, which matches the
+ * solution to third order anywhere in the step. This lets the integrator take
+ * steps as large as accuracy allows while output is written on a separate,
+ * user chosen grid of times. (The Dormand-Prince integrator has its own
+ * higher order interpolant, see dormandprince.h.)
+ */
+
+#ifndef DENSE_H
+#define DENSE_H
+
+#include <cstddef>
+#include "statevector.h"
+
+/**
+ * Cubic Hermite interpolation within a step.
+ *
+ * double t0 : time at start of step.
+ * StateVector y0, f0 : state and derivative at start of step.
+ * double t1 : time at end of step.
+ * StateVector y1, f1 : state and derivative at end of step.
+ * double t : time to interpolate at, t0 <= t <= t1.
+ * return : interpolated state at t.
+ */
+template <std::size_t N, typename T>
+StateVector<N, T> HermiteInterpolate(double t0, const StateVector<N, T> & y0, const StateVector<N, T> & f0,
+	double t1, const StateVector<N, T> & y1, const StateVector<N, T> & f1, double t)
+{
+	double h = t1 - t0;
+	double s = (t - t0)/h;
+
+	// Hermite basis functions.
+	double h00 = (1 + 2*s) * (1 - s) * (1 - s);
+	double h10 = s * (1 - s) * (1 - s);
+	double h01 = s * s * (3 - 2*s);
+	double h11 = s * s * (s - 1);
+
+	return h00 * y0 + (h10 * h) * f0 + h01 * y1 + (h11 * h) * f1;
+}
+
+/**
+ * A uniform grid of output times from startT to finalT inclusive, together
+ * with a cursor marking the next time still to be written.
+ *
+ * Used as:
+ * 	while (grid.Pending(t1)) { write sample at grid.Time(); grid.Advance(); }
+ * after each step ending at t1.
+ */
+class OutputGrid
+{
+public:
+	/**
+	 * double startT : first output time.
+	 * double finalT : last output time.
+	 * long long points : number of output times, at least 2.
+	 */
+	OutputGrid(double startT, double finalT, long long points) :
+		startT(startT), finalT(finalT), points(points), next(0)
+	{}
+
+	// Whether the next output time is at or before t.
+	bool Pending(double t) const
+	{
+		return next < points && (Time() - t) * (finalT - startT) <= 0;
+	}
+
+	// Next output time. The last is exactly finalT.
+	double Time() const
+	{
+		if (next == points - 1)
+			return finalT;
+		return startT + next * (finalT - startT) / (points - 1);
+	}
+
+	// Index of the next output time.
+	long long Index() const
+	{
+		return next;
+	}
+
+	void Advance()
+	{
+		next++;
+	}
+
+private:
+	double startT;
+	double finalT;
+	long long points;
+	long long next;
+};
+
+#endif
@@ -0,0 +1,271 @@
+/**
+ * Native adaptive integrator using the Dormand-Prince 5(4) embedded
+ * Runge-Kutta pair.
+ *
+ * Each step produces a fifth order solution and a fourth order solution from
+ * the same seven stages, and their difference is used as the error estimate.
+ * The last stage of an accepted step is the derivative at the start of the
+ * next step (first same as last), so an accepted step costs six derivative
+ * evaluations. Compare this with step doubling on fourth order Runge-Kutta
+ * (as gsl_odeiv2_step_rk4 does under an evolve object), which costs twelve.
+ *
+ * The step size is chosen with a proportional-integral (PI) controller, which
+ * also takes the error of the previous step into account and so produces
+ * smoother step size sequences with fewer rejections.
+ *
+ * After each accepted step a fourth order continuous extension is available
+ * through Interpolate, so the solution can be sampled anywhere within the
+ * step at the cost of a few vector operations and no extra evaluations.
+ *
+ * See E. Hairer, S. P. Norsett, G. Wanner, Solving Ordinary Differential
+ * Equations I, section II.4 for the coefficients and controller.
+ */
+
+#ifndef DORMANDPRINCE_H
+#define DORMANDPRINCE_H
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "statevector.h"
+
+/**
+ * Dormand-Prince integrator for a system of dimension N. The interface is
+ * modelled on gsl_odeiv2_evolve_apply: each call to Apply advances the
+ * solution by one accepted step, never stepping past the goal time.
+ *
+ * F is the derivative, callable as d(double t, const StateVector<N, T> & y).
+ */
+template <std::size_t N, typename T, typename F>
+class DormandPrince
+{
+public:
+	// Number of accepted and rejected steps, and of derivative evaluations.
+	long long accepted;
+	long long rejected;
+	long long evaluations;
+
+	/**
+	 * Create an integrator for derivative function d. Errors are controlled
+	 * so that for each component |err| < absError + relError * |y|.
+	 *
+	 * F d : derivative function for the problem.
+	 * double absError : absolute error boundary.
+	 * double relError : relative error boundary.
+	 */
+	DormandPrince(F d, double absError, double relError) :
+		accepted(0), rejected(0), evaluations(0),
+		d(d), absError(absError), relError(relError)
+	{
+		Reset();
+	}
+
+	/**
+	 * Forget the stored derivative and controller history, required if the
+	 * state is changed other than by Apply. Counters are not reset.
+	 */
+	void Reset()
+	{
+		haveDerivative = false;
+		errorOld = 1e-4;
+		lastRejected = false;
+	}
+
+	/**
+	 * Advance y by one accepted step, trying smaller steps until the error
+	 * is within the boundary.
+	 *
+	 * double & t : current time, updated to the end of the step.
+	 * double t1 : goal time, the step will not go beyond this.
+	 * double & h : trial step width, updated to the proposed next width.
+	 * StateVector & y : current state, updated to the end of the step.
+	 * return : 0 on success, 1 if the step width became too small or the
+	 * 	error estimate is not finite.
+	 */
+	int Apply(double & t, double t1, double & h, StateVector<N, T> & y)
+	{
+		if (!haveDerivative)
+		{
+			k[0] = d(t, y);
+			evaluations++;
+			haveDerivative = true;
+		}
+
+		while (true)
+		{
+			// Don't step past the goal.
+			bool final = false;
+			if ((t + h - t1) * h > 0)
+			{
+				h = t1 - t;
+				final = true;
+			}
+
+			double err = Attempt(t, h, y);
+
+			// The solution has blown up, no step width will help.
+			if (!std::isfinite(err))
+				return 1;
+
+			if (err <= 1)
+			{
+				// PI control: previous error enters with a small weight.
+				double factor = safety * std::pow(err, -alpha) * std::pow(errorOld, beta);
+				factor = Clamp(factor, lastRejected ? 1.0 : maxFactor);
+
+				errorOld = std::max(err, 1e-4);
+				lastRejected = false;
+
+				PrepareInterpolation(t, h, y);
+
+				t = final ? t1 : t + h;
+				y = yNew;
+				// First same as last.
+				k[0] = k[6];
+				accepted++;
+
+				h *= factor;
+				return 0;
+			}
+
+			// Rejected, shrink using the error of this step only.
+			rejected++;
+			lastRejected = true;
+			h *= Clamp(safety * std::pow(err, -0.2), 1.0);
+
+			if (std::abs(h) <= 10 * std::numeric_limits<double>::epsilon() * std::abs(t))
+				return 1;
+		}
+	}
+
+	/**
+	 * Dense output within the last accepted step.
+	 *
+	 * double t : time to evaluate at, between StepStart() and the time
+	 * 	returned by the last call to Apply.
+	 * return : interpolated state at t.
+	 */
+	StateVector<N, T> Interpolate(double t) const
+	{
+		double theta = (t - tOld) / hUsed;
+		double theta1 = 1 - theta;
+
+		return interpolant[0] + theta * (interpolant[1] + theta1 * (interpolant[2]
+			+ theta * (interpolant[3] + theta1 * interpolant[4])));
+	}
+
+	// Time at the start of the last accepted step.
+	double StepStart() const
+	{
+		return tOld;
+	}
+
+private:
+	F d;
+	double absError;
+	double relError;
+
+	// Stage derivatives, k[0] holds the derivative at the start of a step.
+	StateVector<N, T> k[7];
+	StateVector<N, T> yNew;
+	bool haveDerivative;
+	double errorOld;
+	bool lastRejected;
+
+	// Start and width of the last accepted step, and the coefficients of
+	// its continuous extension.
+	double tOld;
+	double hUsed;
+	StateVector<N, T> interpolant[5];
+
+	static constexpr double safety = 0.9;
+	static constexpr double minFactor = 0.2;
+	static constexpr double maxFactor = 10.0;
+	static constexpr double beta = 0.04;
+	static constexpr double alpha = 0.2 - 0.75 * beta;
+
+	/**
+	 * Restrict a step width factor to [minFactor, upper]. Don't grow
+	 * straight after a rejection, so upper is 1 in that case.
+	 */
+	static double Clamp(double factor, double upper)
+	{
+		if (factor > upper)
+			return upper;
+		if (factor < minFactor)
+			return minFactor;
+		return factor;
+	}
+
+	/**
+	 * Compute the continuous extension coefficients for an accepted step
+	 * from (t, y) of width h, before k[0] is overwritten. See Hairer,
+	 * Norsett and Wanner, section II.6.
+	 */
+	void PrepareInterpolation(double t, double h, const StateVector<N, T> & y)
+	{
+		tOld = t;
+		hUsed = h;
+
+		interpolant[0] = y;
+		interpolant[1] = yNew - y;
+		interpolant[2] = h * k[0] - interpolant[1];
+		interpolant[3] = interpolant[1] - h * k[6] - interpolant[2];
+		interpolant[4] = h * (-12715105075.0/11282082432 * k[0] + 87487479700.0/32700410799 * k[2]
+			- 10690763975.0/1880347072 * k[3] + 701980252875.0/199316789632 * k[4]
+			- 1453857185.0/822651844 * k[5] + 69997945.0/29380423 * k[6]);
+	}
+
+	/**
+	 * Compute the stages for a step of width h from (t, y), leaving the
+	 * fifth order solution in yNew.
+	 *
+	 * return : scaled error norm, a value below 1 means the step is good.
+	 */
+	double Attempt(double t, double h, const StateVector<N, T> & y)
+	{
+		StateVector<N, T> stage;
+
+		stage = y + h * (1.0/5 * k[0]);
+		k[1] = d(t + h/5, stage);
+
+		stage = y + h * (3.0/40 * k[0] + 9.0/40 * k[1]);
+		k[2] = d(t + 3*h/10, stage);
+
+		stage = y + h * (44.0/45 * k[0] - 56.0/15 * k[1] + 32.0/9 * k[2]);
+		k[3] = d(t + 4*h/5, stage);
+
+		stage = y + h * (19372.0/6561 * k[0] - 25360.0/2187 * k[1]
+			+ 64448.0/6561 * k[2] - 212.0/729 * k[3]);
+		k[4] = d(t + 8*h/9, stage);
+
+		stage = y + h * (9017.0/3168 * k[0] - 355.0/33 * k[1] + 46732.0/5247 * k[2]
+			+ 49.0/176 * k[3] - 5103.0/18656 * k[4]);
+		k[5] = d(t + h, stage);
+
+		yNew = y + h * (35.0/384 * k[0] + 500.0/1113 * k[2] + 125.0/192 * k[3]
+			- 2187.0/6784 * k[4] + 11.0/84 * k[5]);
+		k[6] = d(t + h, yNew);
+
+		evaluations += 6;
+
+		// Difference between the fifth and fourth order solutions.
+		StateVector<N, T> error = h * (71.0/57600 * k[0] - 71.0/16695 * k[2]
+			+ 71.0/1920 * k[3] - 17253.0/339200 * k[4] + 22.0/525 * k[5]
+			- 1.0/40 * k[6]);
+
+		// Root mean square of the error relative to the tolerance.
+		double sum = 0;
+		for (std::size_t i = 0; i != N; i++)
+		{
+			double scale = absError + relError * std::max(std::abs((double)y[i]), std::abs((double)yNew[i]));
+			double e = error[i] / scale;
+			sum += e * e;
+		}
+
+		return std::sqrt(sum / N);
+	}
+};
+
+#endif
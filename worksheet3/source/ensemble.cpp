@@ -0,0 +1,333 @@
+/**
+ * Source code for a program which integrates a large ensemble of initial
+ * conditions for the simple harmonic oscillator (v' = -x, x' = v) using the
+ * structure-of-arrays ensemble integrator in ensemble.h.
+ *
+ * Initial conditions are spread evenly over the square -1 < v, x < 1. Only
+ * summary statistics and the trajectories of a few members are written out,
+ * with an optional image of the density of every state reached in phase
+ * space (see rasterizer.h).
+ *
+ * Alternatively integrates an ensemble of pendulums (v' = -sin x, x' = v)
+ * with GSL adaptive steps, where trajectories near the separatrix cost far
+ * more steps than the rest, comparing fixed shards with work stealing.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_odeiv2.h>
+#include "ensemble.h"
+#include "integrate.h"
+#include "rasterizer.h"
+
+/**
+ * Derivative of a block of ensemble members. See report for details of this
+ * equation, c[0] holds v and c[1] holds x.
+ *
+ * double t : Time to evaluate derivatives at.
+ * EnsembleBlock y : v and x for each member.
+ * EnsembleBlock dy : filled with v' and x' for each member.
+ * std::size_t count : number of members in the block.
+ */
+void Derivative(double t, const EnsembleBlock<2> & y, EnsembleBlock<2> & dy, std::size_t count);
+
+/**
+ * InitialCondition gives the starting state of an ensemble member. Uses a
+ * low discrepancy (R2) sequence so the square is covered evenly for any
+ * ensemble size.
+ *
+ * std::size_t member : index of the member.
+ * double y[] : filled with v and x.
+ */
+void InitialCondition(std::size_t member, double y[]);
+
+/**
+ * GSL form of the pendulum derivative, y[0] = v and y[1] = x.
+ */
+int PendulumFunction(double t, const double y[], double f[], void * params);
+
+/**
+ * PendulumEnsemble integrates pendulums released from x = 0 with v evenly
+ * spaced from 0 to 2.5, crossing the separatrix at v = 2, with GSL adaptive
+ * steps. The ensemble is run twice, split into fixed shards and with work
+ * stealing, and the times, steals and balance of steps between threads are
+ * written to file with the step count and energy error statistics. The
+ * density of time spent at each state, with x taken into -pi to pi, can be
+ * written as an image, pendulum_density.pgm.
+ *
+ * std::string filename : output filename.
+ */
+void PendulumEnsemble(std::string filename);
+
+/**
+ * Main function, asks for the ensemble size and integration parameters, then
+ * integrates the ensemble and writes statistics to file.
+ */
+int main()
+{
+	int type;
+	printf("Please input ensemble (1 oscillator with fixed steps, 2 pendulum with adaptive steps): ");
+	while (!(std::cin >> type) || (type != 1 && type != 2))
+	{
+		printf("Enter valid ensemble: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	if (type == 2)
+	{
+		PendulumEnsemble("pendulum_out");
+		printf("Done!\n");
+		return 0;
+	}
+
+	std::size_t members;
+	printf("Please input no. of ensemble members: ");
+	std::cin >> members;
+
+	double startT = 0;
+	double finalT;
+	printf("Please input goal time: ");
+	std::cin >> finalT;
+
+	long long intervals;
+	printf("Please input no. of intervals: ");
+	std::cin >> intervals;
+
+	int order;
+	printf("Please input order of Runge-Kutta method (2 or 4): ");
+	while (!(std::cin >> order) || (order != 2 && order != 4))
+	{
+		printf("Enter valid order: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	std::size_t keep;
+	printf("Please input no. of trajectories to write: ");
+	std::cin >> keep;
+
+	std::size_t pixels;
+	printf("Please input size of density image in pixels (0 for none): ");
+	std::cin >> pixels;
+
+	// Every state stays within radius sqrt(2) of the origin.
+	PhaseHistogram density(pixels, pixels, -1.5, 1.5, -1.5, 1.5);
+
+	// Initial conditions.
+	Ensemble<2> ensemble(members);
+	for (std::size_t i = 0; i != members; i++)
+	{
+		double y[2];
+		InitialCondition(i, y);
+		ensemble.component[0][i] = y[0];
+		ensemble.component[1][i] = y[1];
+	}
+
+	// Keep trajectories spread evenly through the ensemble.
+	std::vector<std::size_t> selected;
+	for (std::size_t i = 0; i < keep && i < members; i++)
+		selected.push_back(i * members / keep);
+
+	printf("Integrating...\n");
+
+	std::vector<EnsembleSample<2> > samples;
+	std::vector<RunningStatistics> statistics = EnsembleIntegrate(Derivative, ensemble, startT, intervals, finalT, order, selected, samples, pixels > 0 ? &density : 0);
+
+	// Compare with the analytic solution, a rotation of the initial state.
+	RunningStatistics error;
+	double c = std::cos(finalT - startT);
+	double s = std::sin(finalT - startT);
+	for (std::size_t i = 0; i != members; i++)
+	{
+		double y[2];
+		InitialCondition(i, y);
+		double v = c * y[0] - s * y[1];
+		double x = s * y[0] + c * y[1];
+		error.Add(std::sqrt((ensemble.component[0][i] - v) * (ensemble.component[0][i] - v)
+			+ (ensemble.component[1][i] - x) * (ensemble.component[1][i] - x)));
+	}
+
+	FILE * file = fopen("ensemble_out", "w");
+
+	printf("Writing to file 'ensemble_out'...\n");
+
+	fprintf(file, "%-20s%-20s%-20s%-20s%-20s\n", "Quantity", "Mean", "Std. Dev.", "Min", "Max");
+	const char * names[2] = {"V", "X"};
+	for (std::size_t i = 0; i != 2; i++)
+	{
+		fprintf(file, "%-20s%-20.15f%-20.15f%-20.15f%-20.15f\n", names[i],
+			statistics[i].mean, statistics[i].StandardDeviation(), statistics[i].min, statistics[i].max);
+	}
+	fprintf(file, "%-20s%-20.15f%-20.15f%-20.15f%-20.15f\n", "Analytic Error",
+		error.mean, error.StandardDeviation(), error.min, error.max);
+
+	fclose(file);
+
+	if (!samples.empty())
+	{
+		file = fopen("ensemble_trajectories_out", "w");
+
+		printf("Writing to file 'ensemble_trajectories_out'...\n");
+
+		fprintf(file, "%-10s%-10s%-20s%-20s%-20s\n", "Member", "Interval", "Time", "Result V", "Result X");
+		for (std::size_t i = 0; i != samples.size(); i++)
+		{
+			fprintf(file, "%-10zu%-10lli%-20.15f%-20.15f%-20.15f\n", samples[i].member,
+				samples[i].interval, samples[i].t, samples[i].y[0], samples[i].y[1]);
+		}
+
+		fclose(file);
+	}
+
+	if (pixels > 0)
+	{
+		printf("Writing to file 'ensemble_density.pgm'...\n");
+		if (!density.WritePGM("ensemble_density.pgm"))
+			printf("Could not write 'ensemble_density.pgm'.\n");
+	}
+
+	printf("Done!\n");
+
+	return 0;
+}
+
+void Derivative(double t, const EnsembleBlock<2> & y, EnsembleBlock<2> & dy, std::size_t count)
+{
+	// See report for details of this equation.
+	for (std::size_t j = 0; j < count; j++)
+	{
+		dy.c[0][j] = -y.c[1][j];
+		dy.c[1][j] = y.c[0][j];
+	}
+}
+
+void InitialCondition(std::size_t member, double y[])
+{
+	// Fractional parts of multiples of the inverse plastic number.
+	double a = 0.7548776662466927;
+	double b = 0.5698402909980532;
+	y[0] = 2 * std::fmod(0.5 + member * a, 1.0) - 1;
+	y[1] = 2 * std::fmod(0.5 + member * b, 1.0) - 1;
+}
+
+int PendulumFunction(double t, const double y[], double f[], void * params)
+{
+	f[0] = -std::sin(y[1]);
+	f[1] = y[0];
+	return GSL_SUCCESS;
+}
+
+void PendulumEnsemble(std::string filename)
+{
+	std::size_t members;
+	printf("Please input no. of ensemble members: ");
+	std::cin >> members;
+
+	double startT = 0;
+	double finalT;
+	printf("Please input goal time: ");
+	std::cin >> finalT;
+
+	double absError;
+	printf("Please enter desired absolute error boundary: ");
+	std::cin >> absError;
+
+	std::size_t chunk;
+	printf("Please input no. of trajectories per chunk: ");
+	std::cin >> chunk;
+
+	std::size_t pixels;
+	printf("Please input size of density image in pixels (0 for none): ");
+	std::cin >> pixels;
+
+	gsl_odeiv2_system sys = {PendulumFunction, 0, 2, 0};
+
+	// Members in order of energy, so the expensive ones near the separatrix
+	// fall together, as they would in a parameter sweep.
+	auto initial = [members](std::size_t member, double y[])
+	{
+		y[0] = 2.5 * member / members;
+		y[1] = 0;
+	};
+
+	unsigned workers = WorkerCount();
+	const char * names[2] = {"Fixed shards", "Work stealing"};
+
+	FILE * file = fopen(filename.c_str(), "w");
+
+	printf("Integrating %zu pendulums on %u threads...\n", members, workers);
+
+	fprintf(file, "%-20s%-20s%-20s%-20s%-20s\n", "Schedule", "Time", "Steals", "Least Steps", "Most Steps");
+
+	RunningStatistics steps, energyError;
+
+	// Density from each thread, filled on the work stealing run.
+	PhaseHistogram density(pixels, pixels, -M_PI, M_PI, -3, 3);
+	std::vector<PhaseHistogram> workerDensity(pixels > 0 ? workers : 0, density);
+
+	for (int stealing = 0; stealing != 2; stealing++)
+	{
+		// Statistics and total steps of each thread.
+		std::vector<RunningStatistics> workerSteps(workers), workerError(workers);
+		std::vector<long long> total(workers, 0);
+
+		auto finish = [&](unsigned worker, std::size_t member, const double y[], long long count, int status)
+		{
+			double y0[2];
+			initial(member, y0);
+			double energy = 0.5 * y0[0] * y0[0] - std::cos(y0[1]);
+
+			workerSteps[worker].Add((double)count);
+			workerError[worker].Add(std::abs(0.5 * y[0] * y[0] - std::cos(y[1]) - energy));
+			total[worker] += count;
+		};
+
+		// Weighted by step width, as adaptive steps crowd where x changes fast.
+		auto observe = [&](unsigned worker, double t, double h, const double y[])
+		{
+			if (stealing == 1 && pixels > 0)
+				workerDensity[worker].Add(y[0], std::remainder(y[1], 2 * M_PI), h);
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		std::size_t steals = GSLEnsembleIntegrate(gsl_odeiv2_step_rkf45, &sys, absError, 0, members, startT, finalT, chunk, stealing == 1, initial, finish, observe);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		long long least = *std::min_element(total.begin(), total.end());
+		long long most = *std::max_element(total.begin(), total.end());
+
+		fprintf(file, "%-20s%-20.6f%-20zu%-20lli%-20lli\n", names[stealing], seconds, steals, least, most);
+		printf("%-20s%10.6f s, %zu steals, steps per thread from %lli to %lli\n", names[stealing], seconds, steals, least, most);
+
+		steps = RunningStatistics();
+		energyError = RunningStatistics();
+		for (unsigned w = 0; w != workers; w++)
+		{
+			steps.Merge(workerSteps[w]);
+			energyError.Merge(workerError[w]);
+		}
+	}
+
+	fprintf(file, "\n%-20s%-20s%-20s%-20s%-20s\n", "Quantity", "Mean", "Std. Dev.", "Min", "Max");
+	fprintf(file, "%-20s%-20.6f%-20.6f%-20.6f%-20.6f\n", "Steps", steps.mean, steps.StandardDeviation(), steps.min, steps.max);
+	fprintf(file, "%-20s%-20.6e%-20.6e%-20.6e%-20.6e\n", "Energy Error", energyError.mean, energyError.StandardDeviation(), energyError.min, energyError.max);
+
+	fclose(file);
+
+	if (pixels > 0)
+	{
+		for (unsigned w = 0; w != workers; w++)
+			density.Merge(workerDensity[w]);
+
+		printf("Writing to file 'pendulum_density.pgm'...\n");
+		if (!density.WritePGM("pendulum_density.pgm"))
+			printf("Could not write 'pendulum_density.pgm'.\n");
+	}
+}
@@ -0,0 +1,237 @@
+/**
+ * Integration of large ensembles of initial conditions through the same
+ * system of ODEs.
+ *
+ * The ensemble is stored structure-of-arrays: component c of every trajectory
+ * is held in one contiguous array. Trajectories are integrated in blocks of
+ * EnsembleBlockSize. A block is copied into small stage arrays and taken
+ * through every step while it stays in cache, then written back. Each
+ * Runge-Kutta stage is a loop over the trajectories of the block, which the
+ * compiler vectorises. The ensemble is split into one shard per thread.
+ *
+ * Only summary statistics, the trajectories of a few selected members and
+ * optionally a phase space density image (see rasterizer.h) are kept, so
+ * memory use does not grow with the number of steps.
+ */
+
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include "statistics.h"
+#include "parallel.h"
+#include "rasterizer.h"
+
+// Number of trajectories integrated together.
+const std::size_t EnsembleBlockSize = 256;
+
+/**
+ * Stage storage for one block of trajectories, c[i][j] is component i of
+ * trajectory j within the block.
+ *
+ * The derivative of an ensemble is a function called as
+ * d(double t, const EnsembleBlock & y, EnsembleBlock & dy, std::size_t count)
+ * which fills the first count entries of each component of dy.
+ */
+template <std::size_t N, typename T = double>
+struct EnsembleBlock
+{
+	T c[N][EnsembleBlockSize];
+};
+
+/**
+ * State of every member of an ensemble, stored structure-of-arrays.
+ */
+template <std::size_t N, typename T = double>
+struct Ensemble
+{
+	std::vector<T> component[N];
+
+	explicit Ensemble(std::size_t count)
+	{
+		for (std::size_t i = 0; i != N; i++)
+			component[i].resize(count);
+	}
+
+	std::size_t Size() const
+	{
+		return component[0].size();
+	}
+};
+
+/**
+ * State of a selected trajectory after a step.
+ */
+template <std::size_t N, typename T = double>
+struct EnsembleSample
+{
+	std::size_t member;
+	long long interval;
+	double t;
+	T y[N];
+};
+
+/**
+ * Working storage for the stages of a block, one per thread.
+ */
+template <std::size_t N, typename T>
+struct EnsembleWorkspace
+{
+	EnsembleBlock<N, T> y, k1, k2, k3, k4, stage;
+};
+
+/**
+ * Apply one step of Runge-Kutta of order 2 (midpoint) or 4 to a block. The
+ * whole block is always stepped, as loops of fixed length vectorise best. The
+ * unused tail of a partly filled block holds stale states from an earlier
+ * block, which are never written back.
+ *
+ * d : derivative function for a block.
+ * EnsembleWorkspace & w : block state in w.y, updated to end of step.
+ * double t : value of t at start of step.
+ * double h : width of step.
+ * int order : 2 or 4.
+ */
+template <typename F, std::size_t N, typename T>
+void EnsembleRungeKuttaStep(F d, EnsembleWorkspace<N, T> & w, double t, double h, int order)
+{
+	d(t, w.y, w.k1, EnsembleBlockSize);
+
+	for (std::size_t i = 0; i != N; i++)
+		for (std::size_t j = 0; j != EnsembleBlockSize; j++)
+			w.stage.c[i][j] = w.y.c[i][j] + (h/2) * w.k1.c[i][j];
+
+	d(t + h/2, w.stage, w.k2, EnsembleBlockSize);
+
+	if (order == 2)
+	{
+		for (std::size_t i = 0; i != N; i++)
+			for (std::size_t j = 0; j != EnsembleBlockSize; j++)
+				w.y.c[i][j] += h * w.k2.c[i][j];
+		return;
+	}
+
+	for (std::size_t i = 0; i != N; i++)
+		for (std::size_t j = 0; j != EnsembleBlockSize; j++)
+			w.stage.c[i][j] = w.y.c[i][j] + (h/2) * w.k2.c[i][j];
+
+	d(t + h/2, w.stage, w.k3, EnsembleBlockSize);
+
+	for (std::size_t i = 0; i != N; i++)
+		for (std::size_t j = 0; j != EnsembleBlockSize; j++)
+			w.stage.c[i][j] = w.y.c[i][j] + h * w.k3.c[i][j];
+
+	d(t + h, w.stage, w.k4, EnsembleBlockSize);
+
+	for (std::size_t i = 0; i != N; i++)
+		for (std::size_t j = 0; j != EnsembleBlockSize; j++)
+			w.y.c[i][j] += (h/6) * (w.k1.c[i][j] + 2 * w.k2.c[i][j] + 2 * w.k3.c[i][j] + w.k4.c[i][j]);
+}
+
+/**
+ * EnsembleIntegrate moves every member of the ensemble from startT to finalT
+ * with a fixed number of Runge-Kutta steps.
+ *
+ * d : derivative function for a block.
+ * Ensemble & ensemble : initial conditions, updated to the states at finalT.
+ * double startT : start time for the initial conditions.
+ * long long intervals : number of intervals to use.
+ * double finalT : goal time.
+ * int order : order of Runge-Kutta method, 2 or 4.
+ * std::vector<std::size_t> selected : members whose trajectories are kept.
+ * std::vector<EnsembleSample> & samples : filled with the state of each
+ * 	selected member after every step, sorted by member.
+ * PhaseHistogram * density : if not null, the state of every member after
+ * 	every step is added to it, with component 0 as V and 1 as X.
+ * return : statistics of each component at finalT.
+ */
+template <typename F, std::size_t N, typename T>
+std::vector<RunningStatistics> EnsembleIntegrate(F d, Ensemble<N, T> & ensemble, double startT, long long intervals, double finalT, int order, std::vector<std::size_t> selected, std::vector<EnsembleSample<N, T> > & samples, PhaseHistogram * density = 0)
+{
+	double h = (finalT - startT)/intervals;
+
+	std::sort(selected.begin(), selected.end());
+
+	// Results from each thread, combined at the end.
+	std::vector<std::vector<RunningStatistics> > statistics(WorkerCount(), std::vector<RunningStatistics>(N));
+	std::vector<std::vector<EnsembleSample<N, T> > > threadSamples(WorkerCount());
+	std::vector<PhaseHistogram> threadDensity;
+	if (density)
+	{
+		threadDensity.assign(WorkerCount(), *density);
+		for (std::size_t worker = 0; worker != threadDensity.size(); worker++)
+			threadDensity[worker].Clear();
+	}
+
+	ParallelFor(ensemble.Size(), [&](unsigned worker, std::size_t begin, std::size_t end)
+	{
+		// Stage arrays are too large for the stack of every thread.
+		// Value initialised, so a partly filled block has no garbage.
+		std::vector<EnsembleWorkspace<N, T> > storage(1);
+		EnsembleWorkspace<N, T> & w = storage[0];
+
+		for (std::size_t first = begin; first < end; first += EnsembleBlockSize)
+		{
+			std::size_t count = std::min(EnsembleBlockSize, end - first);
+
+			for (std::size_t i = 0; i != N; i++)
+				std::copy(&ensemble.component[i][first], &ensemble.component[i][first] + count, w.y.c[i]);
+
+			// Selected members within this block.
+			std::vector<std::size_t>::iterator low = std::lower_bound(selected.begin(), selected.end(), first);
+			std::vector<std::size_t>::iterator high = std::lower_bound(selected.begin(), selected.end(), first + count);
+
+			double t = startT;
+			for (long long n = 0; n != intervals; n++)
+			{
+				EnsembleRungeKuttaStep(d, w, t, h, order);
+				t += h;
+
+				if (density)
+				{
+					for (std::size_t j = 0; j != count; j++)
+						threadDensity[worker].Add(w.y.c[0][j], w.y.c[1][j]);
+				}
+
+				for (std::vector<std::size_t>::iterator it = low; it != high; ++it)
+				{
+					EnsembleSample<N, T> sample;
+					sample.member = *it;
+					sample.interval = n;
+					sample.t = t;
+					for (std::size_t i = 0; i != N; i++)
+						sample.y[i] = w.y.c[i][*it - first];
+					threadSamples[worker].push_back(sample);
+				}
+			}
+
+			for (std::size_t i = 0; i != N; i++)
+			{
+				std::copy(w.y.c[i], w.y.c[i] + count, &ensemble.component[i][first]);
+				for (std::size_t j = 0; j != count; j++)
+					statistics[worker][i].Add(w.y.c[i][j]);
+			}
+		}
+	});
+
+	std::vector<RunningStatistics> result(N);
+	samples.clear();
+
+	for (std::size_t worker = 0; worker != statistics.size(); worker++)
+	{
+		for (std::size_t i = 0; i != N; i++)
+			result[i].Merge(statistics[worker][i]);
+		samples.insert(samples.end(), threadSamples[worker].begin(), threadSamples[worker].end());
+		if (density)
+			density->Merge(threadDensity[worker]);
+	}
+
+	std::stable_sort(samples.begin(), samples.end(),
+		[](const EnsembleSample<N, T> & a, const EnsembleSample<N, T> & b) { return a.member < b.member; });
+
+	return result;
+}
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * Event detection along ODE trajectories.
+ *
+ * An event is a time when some function g(t, y) of the solution crosses zero,
+ * for example a zero crossing of x or a turning point (v = 0). The sign of g
+ * is checked at the end of every step. When it changes, the crossing is
+ * refined with a bracketing root finder run on the dense output of the step,
+ * so no extra derivative evaluations are needed and only the event records
+ * have to be kept. This is the bisection method of worksheet1 (w1q6, w1q7)
+ * with the regula falsi (Illinois) speed up.
+ *
+ * A terminal event stops the integration at the event.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "statevector.h"
+
+/**
+ * Description of an event.
+ *
+ * g : event function, the event happens when g(t, y) = 0.
+ * direction : +1 to detect only rising crossings, -1 only falling, 0 both.
+ * terminal : whether integration should stop at the event.
+ */
+template <std::size_t N, typename T = double>
+struct Event
+{
+	double (*g)(double t, const StateVector<N, T> & y);
+	int direction;
+	bool terminal;
+};
+
+/**
+ * Record of an event that happened, event is its index in the event list.
+ */
+template <std::size_t N, typename T = double>
+struct EventRecord
+{
+	std::size_t event;
+	double t;
+	StateVector<N, T> y;
+};
+
+/**
+ * Find the root of g along the dense output of a step, given a bracket
+ * [a, b] where g changes sign.
+ *
+ * g : event function.
+ * const Dense & dense : step interpolant, provides Interpolate(t).
+ * double a, ga : start of bracket and g there.
+ * double b, gb : end of bracket and g there.
+ * double tolerance : width of bracket to stop at.
+ * return : time of the crossing.
+ */
+template <std::size_t N, typename T, typename Dense>
+double EventRoot(double (*g)(double, const StateVector<N, T> &), const Dense & dense, double a, double ga, double b, double gb, double tolerance)
+{
+	// Which end was kept last time, used to halve its weight (Illinois).
+	int side = 0;
+
+	for (int i = 0; i != 100 && std::abs(b - a) > tolerance; i++)
+	{
+		// Regula falsi, falling back to bisection if that goes outside.
+		double c = (a * gb - b * ga) / (gb - ga);
+		if (!(c > std::min(a, b) && c < std::max(a, b)))
+			c = (a + b)/2;
+
+		double gc = g(c, dense.Interpolate(c));
+
+		if (gc == 0)
+			return c;
+
+		if ((gc < 0) == (gb < 0))
+		{
+			b = c;
+			gb = gc;
+			if (side == -1)
+				ga /= 2;
+			side = -1;
+		}
+		else
+		{
+			a = c;
+			ga = gc;
+			if (side == 1)
+				gb /= 2;
+			side = 1;
+		}
+	}
+
+	return (a + b)/2;
+}
+
+/**
+ * Check every event over the step from t0 to t1, adding a record for each
+ * crossing in time order. If a terminal event happens, later crossings are
+ * dropped.
+ *
+ * const std::vector<Event> & events : events to check.
+ * std::vector<double> & gPrevious : value of each event function at t0,
+ * 	updated to the values at t1.
+ * const Dense & dense : step interpolant, provides Interpolate(t).
+ * double t0 : start of step.
+ * double t1 : end of step.
+ * StateVector y1 : state at end of step.
+ * double tolerance : accuracy of event times.
+ * std::vector<EventRecord> & records : records are appended to this.
+ * return : index into records of the terminal event, or -1 if none.
+ */
+template <std::size_t N, typename T, typename Dense>
+long long LocateEvents(const std::vector<Event<N, T> > & events, std::vector<double> & gPrevious, const Dense & dense, double t0, double t1, const StateVector<N, T> & y1, double tolerance, std::vector<EventRecord<N, T> > & records)
+{
+	std::vector<EventRecord<N, T> > found;
+
+	for (std::size_t i = 0; i != events.size(); i++)
+	{
+		double g0 = gPrevious[i];
+		double g1 = events[i].g(t1, y1);
+		gPrevious[i] = g1;
+
+		// A crossing, or landing exactly on zero from a non-zero value.
+		bool crossed = (g0 < 0 && g1 >= 0) || (g0 > 0 && g1 <= 0);
+		if (!crossed)
+			continue;
+
+		int direction = g1 > g0 ? 1 : -1;
+		if (events[i].direction != 0 && events[i].direction != direction)
+			continue;
+
+		EventRecord<N, T> record;
+		record.event = i;
+		record.t = g1 == 0 ? t1 : EventRoot(events[i].g, dense, t0, g0, t1, g1, tolerance);
+		record.y = dense.Interpolate(record.t);
+		found.push_back(record);
+	}
+
+	// Time order, backwards if integrating backwards.
+	bool forward = t1 > t0;
+	std::stable_sort(found.begin(), found.end(),
+		[forward](const EventRecord<N, T> & a, const EventRecord<N, T> & b) { return forward ? a.t < b.t : a.t > b.t; });
+
+	for (std::size_t i = 0; i != found.size(); i++)
+	{
+		records.push_back(found[i]);
+		if (events[found[i].event].terminal)
+			return records.size() - 1;
+	}
+
+	return -1;
+}
+
+#endif
@@ -0,0 +1,256 @@
+/**
+ * Native adaptive integrator using Gragg-Bulirsch-Stoer extrapolation.
+ *
+ * A step of width H is taken several times with the modified midpoint rule
+ * (Gragg's method) using n = 2, 4, 6, ... substeps. The error of the modified
+ * midpoint rule is a series in even powers of H/n, so Richardson
+ * extrapolation of the results to zero substep width (Aitken-Neville) gains
+ * two orders per column of the table. Column j of the table has order 2j + 2
+ * and the difference between the last two entries of a row is an error
+ * estimate.
+ *
+ * Both the step width and the number of columns (the order) are adapted,
+ * choosing the order which minimises the number of derivative evaluations per
+ * unit time. For smooth problems at tight tolerances this uses a high order
+ * and long steps, and reaches accuracies near rounding error for a small
+ * fraction of the evaluations of a fixed low order method.
+ *
+ * See E. Hairer, S. P. Norsett, G. Wanner, Solving Ordinary Differential
+ * Equations I, section II.9 for the order and step width control (ODEX).
+ */
+
+#ifndef EXTRAPOLATION_H
+#define EXTRAPOLATION_H
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "statevector.h"
+
+/**
+ * Extrapolation integrator for a system of dimension N, with the Apply
+ * interface of DormandPrince.
+ *
+ * F is the derivative, callable as d(double t, const StateVector<N, T> & y).
+ */
+template <std::size_t N, typename T, typename F>
+class BulirschStoer
+{
+public:
+	// Number of accepted and rejected steps, and of derivative evaluations.
+	long long accepted;
+	long long rejected;
+	long long evaluations;
+
+	// Index of the column of the extrapolation table where convergence is
+	// expected next step, the order is 2 * column + 2.
+	int column;
+
+	/**
+	 * Create an integrator for derivative function d. Errors are controlled
+	 * so that for each component |err| < absError + relError * |y|.
+	 *
+	 * F d : derivative function for the problem.
+	 * double absError : absolute error boundary.
+	 * double relError : relative error boundary.
+	 */
+	BulirschStoer(F d, double absError, double relError) :
+		accepted(0), rejected(0), evaluations(0), column(3),
+		d(d), absError(absError), relError(relError), lastRejected(false)
+	{
+		// Substeps n_j = 2(j + 1), and the evaluations needed to fill the
+		// table up to column j (one shared evaluation at the start).
+		for (int j = 0; j != columns; j++)
+		{
+			substeps[j] = 2 * (j + 1);
+			cost[j] = (j == 0 ? 1 : cost[j - 1]) + substeps[j] - 1;
+		}
+	}
+
+	/**
+	 * Advance y by one accepted step, trying smaller steps until the error
+	 * is within the boundary.
+	 *
+	 * double & t : current time, updated to the end of the step.
+	 * double t1 : goal time, the step will not go beyond this.
+	 * double & h : trial step width, updated to the proposed next width.
+	 * StateVector & y : current state, updated to the end of the step.
+	 * return : 0 on success, 1 if the step width became too small or the
+	 * 	error estimate is not finite.
+	 */
+	int Apply(double & t, double t1, double & h, StateVector<N, T> & y)
+	{
+		// Derivative at the start, shared by every row and by retries.
+		f0 = d(t, y);
+		evaluations++;
+
+		while (true)
+		{
+			// Don't step past the goal.
+			bool final = false;
+			if ((t + h - t1) * h > 0)
+			{
+				h = t1 - t;
+				final = true;
+			}
+
+			// Convergence is accepted in columns k - 1 to k + 1.
+			int k = column;
+
+			for (int j = 0; j <= k + 1; j++)
+			{
+				table[j][0] = ModifiedMidpoint(t, h, y, substeps[j]);
+
+				// Aitken-Neville extrapolation to zero substep width.
+				for (int l = 1; l <= j; l++)
+				{
+					double ratio = (double)substeps[j] / substeps[j - l];
+					table[j][l] = table[j][l - 1] + (table[j][l - 1] - table[j - 1][l - 1]) / (ratio * ratio - 1);
+				}
+
+				if (j == 0)
+					continue;
+
+				double err = ScaledError(table[j][j] - table[j][j - 1], y, table[j][j]);
+
+				// The solution has blown up, no step width will help.
+				if (!std::isfinite(err))
+					return 1;
+
+				optimal[j] = h * Clamp(safety * std::pow(0.65 / err, 1.0 / (2*j + 1)));
+				work[j] = cost[j] / std::abs(optimal[j]);
+
+				if (j >= k - 1 && err <= 1)
+				{
+					t = final ? t1 : t + h;
+					y = table[j][j];
+					accepted++;
+
+					h = NextWidth(j, h);
+					lastRejected = false;
+					return 0;
+				}
+			}
+
+			// Rejected, restart from the most efficient column tried.
+			rejected++;
+			lastRejected = true;
+
+			int best = k - 1;
+			for (int j = k; j <= k + 1; j++)
+				if (work[j] < work[best])
+					best = j;
+			column = std::min(std::max(best, (int)minColumn), (int)maxColumn);
+			h = optimal[best];
+
+			if (std::abs(h) <= 10 * std::numeric_limits<double>::epsilon() * std::abs(t))
+				return 1;
+		}
+	}
+
+private:
+	F d;
+	double absError;
+	double relError;
+	bool lastRejected;
+
+	// Number of columns in the table, the highest order is 2 * columns.
+	static const int columns = 9;
+	// Range of the target column, so that k - 1 >= 1 and k + 1 < columns.
+	static const int minColumn = 2;
+	static const int maxColumn = columns - 2;
+
+	static constexpr double safety = 0.94;
+	static constexpr double minFactor = 0.02;
+	static constexpr double maxFactor = 4.0;
+
+	int substeps[columns];
+	double cost[columns];
+
+	// Optimal step width from each column's error, and the evaluations per
+	// unit time that width would give.
+	double optimal[columns];
+	double work[columns];
+
+	StateVector<N, T> f0;
+	StateVector<N, T> table[columns][columns];
+
+	// Restrict a step width factor to [minFactor, maxFactor].
+	static double Clamp(double factor)
+	{
+		if (factor > maxFactor)
+			return maxFactor;
+		if (factor < minFactor)
+			return minFactor;
+		return factor;
+	}
+
+	/**
+	 * Gragg's modified midpoint rule over a step of width H with n substeps,
+	 * n even. The result has an error expansion in even powers of H/n.
+	 */
+	StateVector<N, T> ModifiedMidpoint(double t, double H, const StateVector<N, T> & y, int n)
+	{
+		double h = H / n;
+
+		StateVector<N, T> z0 = y;
+		StateVector<N, T> z1 = y + h * f0;
+
+		for (int m = 1; m != n; m++)
+		{
+			StateVector<N, T> z2 = z0 + (2 * h) * d(t + m * h, z1);
+			z0 = z1;
+			z1 = z2;
+		}
+
+		evaluations += n - 1;
+
+		return z1;
+	}
+
+	/**
+	 * Root mean square of e relative to the error boundary at the larger of
+	 * the states at the start and end of the step.
+	 */
+	double ScaledError(const StateVector<N, T> & e, const StateVector<N, T> & y, const StateVector<N, T> & yNew) const
+	{
+		double sum = 0;
+		for (std::size_t i = 0; i != N; i++)
+		{
+			double scale = absError + relError * std::max(std::abs((double)y[i]), std::abs((double)yNew[i]));
+			double scaled = e[i] / scale;
+			sum += scaled * scaled;
+		}
+		return std::sqrt(sum / N);
+	}
+
+	/**
+	 * Choose the target column and step width after a step accepted in
+	 * column j, from the work per unit time of the neighbouring columns.
+	 */
+	double NextWidth(int j, double h)
+	{
+		int next = j;
+		if (j > minColumn && work[j - 1] < 0.8 * work[j])
+			next = j - 1;
+		else if (j < maxColumn && (j == 1 || work[j] < 0.9 * work[j - 1]))
+			next = j + 1;
+		column = std::min(std::max(next, (int)minColumn), (int)maxColumn);
+
+		double width;
+		if (next == j + 1)
+			// Column j + 1 wasn't computed, estimate from column j.
+			width = optimal[j] * cost[j + 1] / cost[j];
+		else
+			width = optimal[next];
+
+		// Don't grow straight after a rejection.
+		if (lastRejected && std::abs(width) > std::abs(h))
+			width = h;
+
+		return width;
+	}
+};
+
+#endif
@@ -0,0 +1,322 @@
+/**
+ * Integration over a whole span with an observer.
+ *
+ * Rather than calling a GSL driver or evolve function once per step and
+ * writing output between calls, these functions run the whole integration
+ * and call an observer after each accepted step (or at each output time).
+ * The observer is given the time and a reference to the integrator's own
+ * state, so nothing is copied, and returns true to continue or false to stop
+ * early. What is done with each state (writing a row, sampling an output
+ * grid, accumulating statistics) is up to the observer, so output can be
+ * changed without touching the stepping code.
+ *
+ * The GSL versions call gsl_odeiv2_step_apply directly. The derivative at
+ * the end of each step is produced by the stepper and passed into the next
+ * one, so no evaluations are repeated, and it is handed to the observer for
+ * Hermite interpolation (see dense.h) at no cost. Multistep GSL steppers
+ * (msbdf) need a driver and should still be used through one.
+ *
+ * Integration is forward in time, t0 < t1.
+ */
+
+#ifndef INTEGRATE_H
+#define INTEGRATE_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_odeiv2.h>
+#include "statevector.h"
+#include "dense.h"
+#include "parallel.h"
+#include "workstealing.h"
+
+/**
+ * Integrate with a native adaptive integrator (one with the Apply interface
+ * of DormandPrince), calling the observer after every accepted step.
+ *
+ * Solver & solver : integrator.
+ * double & t : start time, updated to the time reached.
+ * double t1 : goal time.
+ * double & h : trial step width, updated to the proposed next width.
+ * StateVector & y : initial state, updated to the state reached.
+ * observe : called as observe(double t, const StateVector & y, double h)
+ * 	with the end and width of each step, returns false to stop.
+ * return : 0 on success, 1 if the step width became too small.
+ */
+template <typename Solver, std::size_t N, typename T, typename Observer>
+int Integrate(Solver & solver, double & t, double t1, double & h, StateVector<N, T> & y, Observer observe)
+{
+	while (t < t1)
+	{
+		double start = t;
+
+		int s = solver.Apply(t, t1, h, y);
+		if (s != 0)
+			return s;
+
+		if (!observe(t, y, t - start))
+			break;
+	}
+
+	return 0;
+}
+
+/**
+ * Integrate with a native adaptive integrator which has dense output,
+ * calling the observer at each time of an output grid instead of at each
+ * step.
+ *
+ * Solver & solver : integrator, provides Interpolate(t).
+ * double & t : start time, updated to the time reached.
+ * double t1 : goal time.
+ * double & h : trial step width, updated to the proposed next width.
+ * StateVector & y : initial state, updated to the state reached.
+ * OutputGrid & grid : output times, advanced past each time observed.
+ * observe : called as observe(double t, const StateVector & y, double h)
+ * 	with an output time, the state there and the width of the step it
+ * 	falls in, returns false to stop.
+ * return : 0 on success, 1 if the step width became too small.
+ */
+template <typename Solver, std::size_t N, typename T, typename Observer>
+int IntegrateOutput(Solver & solver, double & t, double t1, double & h, StateVector<N, T> & y, OutputGrid & grid, Observer observe)
+{
+	while (t < t1)
+	{
+		int s = solver.Apply(t, t1, h, y);
+		if (s != 0)
+			return s;
+
+		while (grid.Pending(t))
+		{
+			if (!observe(grid.Time(), solver.Interpolate(grid.Time()), t - solver.StepStart()))
+				return 0;
+			grid.Advance();
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Integrate with a GSL stepper using a fixed number of steps of the same
+ * width, calling the observer after every step.
+ *
+ * gsl_odeiv2_step * step : GSL stepper.
+ * const gsl_odeiv2_system * sys : GSL system.
+ * double & t : start time, updated to the time reached.
+ * double y[] : initial state, updated to the state reached.
+ * double h : step width.
+ * long long intervals : number of steps.
+ * observe : called as observe(double t, const double y[],
+ * 	const double dydt[], double h) with the end of each step, the state
+ * 	and derivative there and the step width, returns false to stop.
+ * return : GSL_SUCCESS, or the error status of the stepper.
+ */
+template <typename Observer>
+int GSLIntegrateFixed(gsl_odeiv2_step * step, const gsl_odeiv2_system * sys, double & t, double y[], double h, long long intervals, Observer observe)
+{
+	std::size_t n = sys->dimension;
+	std::vector<double> yerr(n), dydtIn(n), dydtOut(n);
+
+	int s = sys->function(t, y, &dydtIn[0], sys->params);
+	if (s != GSL_SUCCESS)
+		return s;
+
+	for (long long i = 0; i != intervals; i++)
+	{
+		s = gsl_odeiv2_step_apply(step, t, h, y, &yerr[0], &dydtIn[0], &dydtOut[0], sys);
+		if (s != GSL_SUCCESS)
+			return s;
+
+		t += h;
+		dydtIn.swap(dydtOut);
+
+		if (!observe(t, (const double *)y, (const double *)&dydtIn[0], h))
+			break;
+	}
+
+	return GSL_SUCCESS;
+}
+
+/**
+ * Integrate with a GSL stepper and step width control, as
+ * gsl_odeiv2_evolve_apply does, calling the observer after every accepted
+ * step.
+ *
+ * gsl_odeiv2_step * step : GSL stepper.
+ * gsl_odeiv2_control * control : GSL step width control.
+ * const gsl_odeiv2_system * sys : GSL system.
+ * double & t : start time, updated to the time reached.
+ * double t1 : goal time, the last step is shortened to end on it.
+ * double & h : trial step width, updated to the proposed next width.
+ * double y[] : initial state, updated to the state reached.
+ * observe : called as observe(double t, const double y[],
+ * 	const double dydt[], double h) with the end of each step, the state
+ * 	and derivative there and the step width, returns false to stop.
+ * return : GSL_SUCCESS, GSL_FAILURE if the step width became too small, or
+ * 	the error status of the stepper.
+ */
+template <typename Observer>
+int GSLIntegrateAdaptive(gsl_odeiv2_step * step, gsl_odeiv2_control * control, const gsl_odeiv2_system * sys, double & t, double t1, double & h, double y[], Observer observe)
+{
+	std::size_t n = sys->dimension;
+	std::vector<double> y0(n), yerr(n), dydtIn(n), dydtOut(n);
+
+	int s = sys->function(t, y, &dydtIn[0], sys->params);
+	if (s != GSL_SUCCESS)
+		return s;
+
+	while (t < t1)
+	{
+		// Don't step past the goal.
+		bool final = false;
+		double width = h;
+		if (t + width >= t1)
+		{
+			width = t1 - t;
+			final = true;
+		}
+
+		// Kept in case the step is rejected.
+		for (std::size_t i = 0; i != n; i++)
+			y0[i] = y[i];
+
+		s = gsl_odeiv2_step_apply(step, t, width, y, &yerr[0], &dydtIn[0], &dydtOut[0], sys);
+		if (s != GSL_SUCCESS)
+		{
+			for (std::size_t i = 0; i != n; i++)
+				y[i] = y0[i];
+			return s;
+		}
+
+		double adjusted = width;
+		int adjust = gsl_odeiv2_control_hadjust(control, step, y, &yerr[0], &dydtOut[0], &adjusted);
+
+		if (adjust == GSL_ODEIV_HADJ_DEC)
+		{
+			// Rejected, retry with the smaller width.
+			for (std::size_t i = 0; i != n; i++)
+				y[i] = y0[i];
+			h = adjusted;
+
+			if (std::abs(h) <= 10 * std::numeric_limits<double>::epsilon() * std::abs(t))
+				return GSL_FAILURE;
+			continue;
+		}
+
+		t = final ? t1 : t + width;
+		// Keep the proposed width, unless it came from a final short step.
+		if (!final)
+			h = adjusted;
+		dydtIn.swap(dydtOut);
+
+		if (!observe(t, (const double *)y, (const double *)&dydtIn[0], width))
+			break;
+	}
+
+	return GSL_SUCCESS;
+}
+
+/**
+ * GSL objects for adaptive integration belonging to one thread, allocated
+ * once and reset between trajectories.
+ */
+struct GSLWorkspace
+{
+	gsl_odeiv2_step * step;
+	gsl_odeiv2_control * control;
+	gsl_odeiv2_evolve * evolve;
+	std::vector<double> y;
+};
+
+/**
+ * GSLEnsembleIntegrate integrates an ensemble of trajectories of a system
+ * from startT to finalT with GSL adaptive stepping (gsl_odeiv2_evolve_apply)
+ * on all threads. Trajectories from different initial conditions may take
+ * very different numbers of steps, so they are balanced with work stealing
+ * (see workstealing.h) in chunks. Every thread has its own stepper, control
+ * and evolve objects, so nothing is allocated per trajectory.
+ *
+ * const gsl_odeiv2_step_type * type : GSL stepper type.
+ * const gsl_odeiv2_system * sys : GSL system, shared by all threads, so its
+ * 	params must only be read.
+ * double absError : absolute error boundary.
+ * double relError : relative error boundary.
+ * std::size_t members : number of trajectories.
+ * double startT : start time for the initial conditions.
+ * double finalT : goal time.
+ * std::size_t chunk : trajectories per chunk.
+ * bool stealing : balance with work stealing, or, for comparison, split into
+ * 	one fixed shard per thread as ParallelFor does.
+ * initial : called as initial(std::size_t member, double y[]) to fill the
+ * 	initial conditions of a member.
+ * finish : called as finish(unsigned worker, std::size_t member,
+ * 	const double y[], long long steps, int status) with the state reached,
+ * 	the number of accepted steps and the GSL status.
+ * observe : called as observe(unsigned worker, double t, double h,
+ * 	const double y[]) after every step, with the width h of the step which
+ * 	reached y at t, e.g. to add the state to a PhaseHistogram.
+ * return : number of chunks stolen.
+ */
+template <typename Initial, typename Finish, typename Observe>
+std::size_t GSLEnsembleIntegrate(const gsl_odeiv2_step_type * type, const gsl_odeiv2_system * sys, double absError, double relError, std::size_t members, double startT, double finalT, std::size_t chunk, bool stealing, Initial initial, Finish finish, Observe observe)
+{
+	std::vector<GSLWorkspace> workspaces(WorkerCount());
+	for (std::size_t i = 0; i != workspaces.size(); i++)
+	{
+		workspaces[i].step = gsl_odeiv2_step_alloc(type, sys->dimension);
+		workspaces[i].control = gsl_odeiv2_control_y_new(absError, relError);
+		workspaces[i].evolve = gsl_odeiv2_evolve_alloc(sys->dimension);
+		workspaces[i].y.resize(sys->dimension);
+	}
+
+	auto work = [&](unsigned worker, std::size_t begin, std::size_t end)
+	{
+		GSLWorkspace & w = workspaces[worker];
+
+		for (std::size_t member = begin; member != end; member++)
+		{
+			gsl_odeiv2_step_reset(w.step);
+			gsl_odeiv2_evolve_reset(w.evolve);
+			initial(member, &w.y[0]);
+
+			double t = startT;
+			// Initial width, will be changed by the control immediately.
+			double h = 1e-3;
+			long long steps = 0;
+			int s = GSL_SUCCESS;
+
+			while (t < finalT && s == GSL_SUCCESS)
+			{
+				double previous = t;
+				s = gsl_odeiv2_evolve_apply(w.evolve, w.control, w.step, sys, &t, finalT, &h, &w.y[0]);
+				steps++;
+
+				if (s == GSL_SUCCESS)
+					observe(worker, t, t - previous, (const double *)&w.y[0]);
+			}
+
+			finish(worker, member, (const double *)&w.y[0], steps, s);
+		}
+	};
+
+	std::size_t steals = 0;
+	if (stealing)
+		steals = WorkStealingFor(members, chunk, work);
+	else
+		ParallelFor(members, work);
+
+	for (std::size_t i = 0; i != workspaces.size(); i++)
+	{
+		gsl_odeiv2_evolve_free(workspaces[i].evolve);
+		gsl_odeiv2_control_free(workspaces[i].control);
+		gsl_odeiv2_step_free(workspaces[i].step);
+	}
+
+	return steals;
+}
+
+#endif
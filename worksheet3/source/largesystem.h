@@ -0,0 +1,320 @@
+/**
+ * Large systems of coupled oscillators: chains and lattices of 10^5 or more
+ * masses, each coupled to its neighbours by springs, with
+ *
+ * 	x_i'' = -omega^2 x_i + kappa * sum over neighbours j of (x_j - x_i).
+ *
+ * StateVector holds its components on the stack and suits small systems.
+ * Here the state is kept as two contiguous arrays, positions and velocities,
+ * and the derivative is evaluated on all threads of a ThreadTeam (see
+ * parallel.h), each taking cache sized blocks of masses in turn.
+ *
+ * At this size a step is limited by memory bandwidth rather than arithmetic,
+ * so the steppers fuse the whole step into a single pass over memory. An
+ * unfused second order Runge-Kutta step makes four passes (derivative,
+ * stage, derivative, update) through seven arrays. The fused step reads x
+ * and v once and writes the new x and v once, computing the stage values of
+ * neighbours on the fly instead of storing them. New values go to separate
+ * arrays, swapped in after the pass, so no thread overwrites a value its
+ * neighbour still needs. The results are identical to the unfused step.
+ *
+ * Systems don't depend on time, so steps don't take a time argument.
+ */
+
+#ifndef LARGESYSTEM_H
+#define LARGESYSTEM_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include "parallel.h"
+
+/**
+ * State of a large system of oscillators.
+ *
+ * x : positions.
+ * v : velocities.
+ * a : accelerations at x, kept between velocity Verlet steps.
+ */
+struct LargeState
+{
+	std::vector<double> x;
+	std::vector<double> v;
+	std::vector<double> a;
+
+	explicit LargeState(std::size_t size = 0) :
+		x(size, 0.0), v(size, 0.0), a(size, 0.0)
+	{
+	}
+
+	std::size_t Size() const
+	{
+		return x.size();
+	}
+};
+
+/**
+ * Chain of oscillators, each coupled to the next, with the ends coupled to
+ * fixed walls.
+ */
+struct OscillatorChain
+{
+	std::size_t size;
+	// Square of the natural frequency of each mass, and spring constant of
+	// the coupling (both per unit mass).
+	double omega2;
+	double kappa;
+
+	/**
+	 * Acceleration of mass i.
+	 *
+	 * std::size_t i : mass.
+	 * P position : position of any mass, called as position(j).
+	 */
+	template <typename P>
+	double Acceleration(std::size_t i, P position) const
+	{
+		double xi = position(i);
+		double left = i > 0 ? position(i - 1) : 0;
+		double right = i + 1 < size ? position(i + 1) : 0;
+		return -omega2 * xi + kappa * (left - 2 * xi + right);
+	}
+
+	/**
+	 * Total energy per unit mass, conserved by the exact solution.
+	 */
+	double Energy(const LargeState & state) const
+	{
+		double energy = 0.5 * kappa * (state.x[0] * state.x[0] + state.x[size - 1] * state.x[size - 1]);
+		for (std::size_t i = 0; i != size; i++)
+		{
+			energy += 0.5 * (state.v[i] * state.v[i] + omega2 * state.x[i] * state.x[i]);
+			if (i + 1 < size)
+				energy += 0.5 * kappa * (state.x[i + 1] - state.x[i]) * (state.x[i + 1] - state.x[i]);
+		}
+		return energy;
+	}
+};
+
+/**
+ * Square lattice of oscillators, width by height, each coupled to its four
+ * neighbours with periodic boundaries. Mass (r, c) is stored at r * width + c.
+ */
+struct OscillatorLattice
+{
+	std::size_t width;
+	std::size_t height;
+	double omega2;
+	double kappa;
+
+	template <typename P>
+	double Acceleration(std::size_t i, P position) const
+	{
+		std::size_t size = width * height;
+		std::size_t c = i % width;
+
+		double xi = position(i);
+		double left = position(c > 0 ? i - 1 : i + width - 1);
+		double right = position(c + 1 < width ? i + 1 : i + 1 - width);
+		double up = position(i >= width ? i - width : i + size - width);
+		double down = position(i + width < size ? i + width : i + width - size);
+		return -omega2 * xi + kappa * (left + right + up + down - 4 * xi);
+	}
+
+	double Energy(const LargeState & state) const
+	{
+		double energy = 0;
+		for (std::size_t i = 0; i != width * height; i++)
+		{
+			std::size_t c = i % width;
+			std::size_t right = c + 1 < width ? i + 1 : i + 1 - width;
+			std::size_t down = (i + width) % (width * height);
+
+			energy += 0.5 * (state.v[i] * state.v[i] + omega2 * state.x[i] * state.x[i]);
+			energy += 0.5 * kappa * ((state.x[right] - state.x[i]) * (state.x[right] - state.x[i])
+				+ (state.x[down] - state.x[i]) * (state.x[down] - state.x[i]));
+		}
+		return energy;
+	}
+};
+
+/**
+ * Steppers for a large system, holding the arrays each step writes into so
+ * they are allocated once.
+ *
+ * System provides Acceleration(i, position) as OscillatorChain does.
+ */
+template <typename System>
+class LargeIntegrator
+{
+public:
+	/**
+	 * const System & system : system to integrate, must outlive this.
+	 * ThreadTeam & team : threads to evaluate on.
+	 * std::size_t size : number of masses.
+	 * std::size_t block : masses per block handed to a thread.
+	 */
+	LargeIntegrator(const System & system, ThreadTeam & team, std::size_t size, std::size_t block = 4096) :
+		system(system), team(team), block(block), next(size)
+	{
+	}
+
+	/**
+	 * One fused step of the second order (midpoint) Runge-Kutta method, in
+	 * one pass. Equivalent to RungeKuttaStep.
+	 *
+	 * LargeState & state : state, updated to the end of the step.
+	 * double h : width of step.
+	 */
+	void MidpointStep(LargeState & state, double h)
+	{
+		const double * x = &state.x[0];
+		const double * v = &state.v[0];
+		double * x1 = &next.x[0];
+		double * v1 = &next.v[0];
+		double half = h * 0.5;
+
+		team.Run(state.Size(), block, [&](unsigned, std::size_t begin, std::size_t end)
+		{
+			auto position = [x](std::size_t j) { return x[j]; };
+			// Midpoint stage position, from the start of the step.
+			auto stage = [x, v, half](std::size_t j) { return x[j] + half * v[j]; };
+
+			for (std::size_t i = begin; i != end; i++)
+			{
+				double a0 = system.Acceleration(i, position);
+				double vm = v[i] + half * a0;
+				x1[i] = x[i] + h * vm;
+				v1[i] = v[i] + h * system.Acceleration(i, stage);
+			}
+		});
+
+		state.x.swap(next.x);
+		state.v.swap(next.v);
+	}
+
+	/**
+	 * The same step as MidpointStep, evaluated the usual way: one pass per
+	 * derivative evaluation and per vector update, storing every
+	 * intermediate array. For comparison.
+	 */
+	void UnfusedMidpointStep(LargeState & state, double h)
+	{
+		std::size_t size = state.Size();
+		stageX.resize(size);
+		stageV.resize(size);
+		k0.resize(size);
+		k1.resize(size);
+
+		const double * x = &state.x[0];
+		const double * v = &state.v[0];
+		double * xm = &stageX[0];
+		double * vm = &stageV[0];
+		double * a0 = &k0[0];
+		double * am = &k1[0];
+		double * x1 = &next.x[0];
+		double * v1 = &next.v[0];
+		double half = h * 0.5;
+
+		team.Run(size, block, [&](unsigned, std::size_t begin, std::size_t end)
+		{
+			auto position = [x](std::size_t j) { return x[j]; };
+			for (std::size_t i = begin; i != end; i++)
+				a0[i] = system.Acceleration(i, position);
+		});
+
+		team.Run(size, block, [&](unsigned, std::size_t begin, std::size_t end)
+		{
+			for (std::size_t i = begin; i != end; i++)
+			{
+				xm[i] = x[i] + half * v[i];
+				vm[i] = v[i] + half * a0[i];
+			}
+		});
+
+		team.Run(size, block, [&](unsigned, std::size_t begin, std::size_t end)
+		{
+			auto position = [xm](std::size_t j) { return xm[j]; };
+			for (std::size_t i = begin; i != end; i++)
+				am[i] = system.Acceleration(i, position);
+		});
+
+		team.Run(size, block, [&](unsigned, std::size_t begin, std::size_t end)
+		{
+			for (std::size_t i = begin; i != end; i++)
+			{
+				x1[i] = x[i] + h * vm[i];
+				v1[i] = v[i] + h * am[i];
+			}
+		});
+
+		state.x.swap(next.x);
+		state.v.swap(next.v);
+	}
+
+	/**
+	 * Compute the accelerations in state.a, required before the first
+	 * VerletStep and whenever x is changed other than by VerletStep.
+	 */
+	void PrepareVerlet(LargeState & state)
+	{
+		const double * x = &state.x[0];
+		double * a = &state.a[0];
+
+		team.Run(state.Size(), block, [&](unsigned, std::size_t begin, std::size_t end)
+		{
+			auto position = [x](std::size_t j) { return x[j]; };
+			for (std::size_t i = begin; i != end; i++)
+				a[i] = system.Acceleration(i, position);
+		});
+	}
+
+	/**
+	 * One fused velocity Verlet step, in one pass: reads x, v and a and
+	 * writes their new values. Symplectic, so the energy error stays
+	 * bounded (see symplectic.h).
+	 *
+	 * LargeState & state : state, with a set, updated to the end of the
+	 * 	step.
+	 * double h : width of step.
+	 */
+	void VerletStep(LargeState & state, double h)
+	{
+		const double * x = &state.x[0];
+		const double * v = &state.v[0];
+		const double * a = &state.a[0];
+		double * x1 = &next.x[0];
+		double * v1 = &next.v[0];
+		double * a1 = &next.a[0];
+		double half = h * 0.5;
+
+		team.Run(state.Size(), block, [&](unsigned, std::size_t begin, std::size_t end)
+		{
+			// New position of any mass, from its start of step values.
+			auto position = [x, v, a, h, half](std::size_t j) { return x[j] + h * (v[j] + half * a[j]); };
+
+			for (std::size_t i = begin; i != end; i++)
+			{
+				double vHalf = v[i] + half * a[i];
+				x1[i] = x[i] + h * vHalf;
+				a1[i] = system.Acceleration(i, position);
+				v1[i] = vHalf + half * a1[i];
+			}
+		});
+
+		state.x.swap(next.x);
+		state.v.swap(next.v);
+		state.a.swap(next.a);
+	}
+
+private:
+	const System & system;
+	ThreadTeam & team;
+	std::size_t block;
+	// Values at the end of a step.
+	LargeState next;
+	// Intermediate arrays of UnfusedMidpointStep.
+	std::vector<double> stageX, stageV, k0, k1;
+};
+
+#endif
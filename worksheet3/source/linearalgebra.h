@@ -0,0 +1,80 @@
+/**
+ * Dense linear algebra shared by the implicit integrators (stiff.h) and the
+ * Newton iterations of the boundary value solvers (bvp.h): LU decomposition
+ * with partial pivoting of a small row major matrix, and solution of linear
+ * systems with its factors. The matrices are at most a few dozen rows, so
+ * plain loops are used rather than a library.
+ */
+
+#ifndef LINEARALGEBRA_H
+#define LINEARALGEBRA_H
+
+#include <cmath>
+#include <algorithm>
+
+/**
+ * LU decomposition with partial pivoting, in place.
+ *
+ * double a[] : n by n row major matrix, replaced by its L and U factors.
+ * int n : size of the matrix.
+ * int pivot[] : filled with the row interchanges.
+ * return : 0 on success, 1 if the matrix is singular.
+ */
+inline int LUDecompose(double a[], int n, int pivot[])
+{
+	for (int k = 0; k != n; k++)
+	{
+		// Largest element in column k at or below the diagonal.
+		int p = k;
+		for (int i = k + 1; i < n; i++)
+			if (std::abs(a[i*n + k]) > std::abs(a[p*n + k]))
+				p = i;
+
+		pivot[k] = p;
+		if (a[p*n + k] == 0)
+			return 1;
+
+		if (p != k)
+			for (int j = 0; j != n; j++)
+				std::swap(a[k*n + j], a[p*n + j]);
+
+		for (int i = k + 1; i < n; i++)
+		{
+			double m = a[i*n + k] / a[k*n + k];
+			a[i*n + k] = m;
+			for (int j = k + 1; j < n; j++)
+				a[i*n + j] -= m * a[k*n + j];
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Solve a x = b using the factors from LUDecompose.
+ *
+ * const double lu[] : factors from LUDecompose.
+ * int n : size of the matrix.
+ * const int pivot[] : row interchanges from LUDecompose.
+ * double b[] : right hand side, replaced by the solution x.
+ */
+inline void LUSolve(const double lu[], int n, const int pivot[], double b[])
+{
+	for (int k = 0; k != n; k++)
+		std::swap(b[k], b[pivot[k]]);
+
+	// Forward substitution, L has a unit diagonal.
+	for (int i = 0; i != n; i++)
+		for (int j = 0; j < i; j++)
+			b[i] -= lu[i*n + j] * b[j];
+
+	// Back substitution.
+	for (int i = n - 1; i >= 0; i--)
+	{
+		for (int j = i + 1; j < n; j++)
+			b[i] -= lu[i*n + j] * b[j];
+		b[i] /= lu[i*n + i];
+	}
+}
+
+#endif
@@ -0,0 +1,243 @@
+/**
+ * Helpers for running independent pieces of work on several threads.
+ *
+ * The convergence sweeps (Euler, RungeKuttaError, GSLError) integrate the same
+ * problem with n = 10^(i/2) steps for each level i. The levels are independent
+ * so they can run in parallel, but the cost of a level grows with n and the
+ * last level costs as much as all the others put together. ParallelSweep
+ * therefore hands out levels largest first, so the most expensive ones start
+ * straight away and the cheap ones fill in around them.
+ *
+ * ThreadTeam keeps its threads between calls, for work which is split many
+ * times a second (such as every derivative evaluation of a large system),
+ * where starting new threads each time would cost more than the work.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Number of worker threads to use, one per hardware thread.
+ *
+ * return : number of threads, at least one.
+ */
+inline unsigned WorkerCount()
+{
+	unsigned count = std::thread::hardware_concurrency();
+	return count == 0 ? 1 : count;
+}
+
+/**
+ * SweepSteps gives the number of steps for each level of a convergence sweep,
+ * n = 10^(i/2) for i = 0 .. 2*maxIntervals. 64 bit integers are used so that
+ * sweeps beyond 10^9 steps don't overflow.
+ *
+ * int maxIntervals : highest power of ten to use.
+ * return : step count for each level.
+ */
+inline std::vector<long long> SweepSteps(int maxIntervals)
+{
+	std::vector<long long> steps;
+
+	for (int i = 0; i <= maxIntervals*2; i++)
+		steps.push_back((long long)std::pow(10, i*0.5));
+
+	return steps;
+}
+
+/**
+ * ParallelSweep runs work(worker, level, steps[level]) for every level, using
+ * up to WorkerCount() threads. worker is the index of the calling thread, in
+ * [0, WorkerCount()), so that each thread can own state such as a GSL driver
+ * which must not be shared. Results are returned in level order.
+ *
+ * const std::vector<long long> & steps : step count for each level.
+ * work : function called as work(unsigned, std::size_t, long long),
+ * 	returning a Result.
+ * return : result of each level.
+ */
+template <typename Result, typename Work>
+std::vector<Result> ParallelSweep(const std::vector<long long> & steps, Work work)
+{
+	std::vector<Result> results(steps.size());
+
+	// Largest levels first.
+	std::vector<std::size_t> order(steps.size());
+	for (std::size_t i = 0; i != order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(),
+		[&steps](std::size_t a, std::size_t b) { return steps[a] > steps[b]; });
+
+	std::atomic<std::size_t> next(0);
+
+	auto worker = [&](unsigned id)
+	{
+		std::size_t i;
+		while ((i = next++) < order.size())
+			results[order[i]] = work(id, order[i], steps[order[i]]);
+	};
+
+	unsigned count = std::min<std::size_t>(WorkerCount(), steps.size());
+	std::vector<std::thread> threads;
+
+	for (unsigned id = 1; id < count; id++)
+		threads.push_back(std::thread(worker, id));
+
+	// The calling thread does its share as worker 0.
+	worker(0);
+
+	for (std::size_t i = 0; i != threads.size(); i++)
+		threads[i].join();
+
+	return results;
+}
+
+/**
+ * ParallelFor splits the range [0, count) into one contiguous shard per
+ * worker thread and calls work(worker, begin, end) for each shard. Suited to
+ * work of even cost, such as a fixed step ensemble.
+ *
+ * std::size_t count : size of the range to split.
+ * work : function called as work(unsigned, std::size_t, std::size_t).
+ */
+template <typename Work>
+void ParallelFor(std::size_t count, Work work)
+{
+	unsigned workers = std::max<std::size_t>(1, std::min<std::size_t>(WorkerCount(), count));
+	std::vector<std::thread> threads;
+
+	for (unsigned id = 1; id < workers; id++)
+		threads.push_back(std::thread(work, id, count * id / workers, count * (id + 1) / workers));
+
+	work(0u, (std::size_t)0, count / workers);
+
+	for (std::size_t i = 0; i != threads.size(); i++)
+		threads[i].join();
+}
+
+/**
+ * Team of worker threads which persist between calls to Run. Run splits a
+ * range into blocks and the threads (the caller being one of them) take
+ * blocks in turn until none are left, so a block can be sized to fit in
+ * cache and uneven blocks balance out.
+ */
+class ThreadTeam
+{
+public:
+	/**
+	 * unsigned workers : number of threads including the caller, at least
+	 * 	one.
+	 */
+	explicit ThreadTeam(unsigned workers = WorkerCount()) :
+		workers(std::max(1u, workers)), generation(0), running(0), stop(false)
+	{
+		for (unsigned id = 1; id < this->workers; id++)
+			threads.push_back(std::thread(&ThreadTeam::Wait, this, id));
+	}
+
+	~ThreadTeam()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+
+		for (std::size_t i = 0; i != threads.size(); i++)
+			threads[i].join();
+	}
+
+	unsigned Size() const
+	{
+		return workers;
+	}
+
+	/**
+	 * Call work(worker, begin, end) for blocks [begin, end) covering
+	 * [0, count), returning once every block is done. worker is the index
+	 * of the calling thread, in [0, Size()).
+	 *
+	 * std::size_t count : size of the range to split.
+	 * std::size_t block : size of each block (the last may be smaller).
+	 * work : function called as work(unsigned, std::size_t, std::size_t).
+	 */
+	template <typename Work>
+	void Run(std::size_t count, std::size_t block, Work work)
+	{
+		std::atomic<std::size_t> next(0);
+
+		auto take = [&](unsigned id)
+		{
+			std::size_t begin;
+			while ((begin = next.fetch_add(block)) < count)
+				work(id, begin, std::min(begin + block, count));
+		};
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = take;
+			running = workers - 1;
+			generation++;
+		}
+		wake.notify_all();
+
+		take(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return running == 0; });
+		task = nullptr;
+	}
+
+private:
+	unsigned workers;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::function<void(unsigned)> task;
+	// Incremented for each call to Run, so each thread takes part once.
+	unsigned long long generation;
+	unsigned running;
+	bool stop;
+
+	void Wait(unsigned id)
+	{
+		unsigned long long seen = 0;
+
+		while (true)
+		{
+			std::function<void(unsigned)> current;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stop || generation != seen; });
+				if (stop)
+					return;
+				seen = generation;
+				current = task;
+			}
+
+			current(id);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running--;
+			}
+			done.notify_one();
+		}
+	}
+
+	ThreadTeam(const ThreadTeam &);
+	ThreadTeam & operator=(const ThreadTeam &);
+};
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * Parareal integration, parallel in time.
+ *
+ * A single trajectory can't be split across threads step by step, as each
+ * step needs the one before. Parareal (Lions, Maday and Turinici) instead
+ * splits [startT, finalT] into time slices and uses two propagators: a cheap,
+ * inaccurate coarse one G and an accurate, expensive fine one F. The coarse
+ * propagator runs through the slices in sequence to give starting states for
+ * every slice, then each iteration
+ *
+ * 	1. runs the fine propagator over every slice at once, from the current
+ * 	   starting states, on all threads, and
+ * 	2. corrects the starting states in sequence with the coarse propagator,
+ * 	   U[n+1] = G(U[n]) + F(U_old[n]) - G(U_old[n]).
+ *
+ * After k iterations the first k slices are exactly as the serial fine
+ * solution would have them, so the method always converges within one
+ * iteration per slice, but usually the states settle much sooner. With K
+ * iterations over P slices on P threads the fine work takes the time of K
+ * slices rather than P, so the speedup is at most P/K.
+ */
+
+#ifndef PARAREAL_H
+#define PARAREAL_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "statevector.h"
+#include "parallel.h"
+
+/**
+ * Progress of one Parareal iteration.
+ *
+ * defect : largest change of any slice starting state in the iteration.
+ * fineSolves : number of slices the fine propagator was run over.
+ */
+struct PararealIteration
+{
+	double defect;
+	std::size_t fineSolves;
+};
+
+/**
+ * Integrate with Parareal from startT to finalT.
+ *
+ * The propagators are called as g(double t0, double t1, const StateVector &
+ * y) and return the state at t1 from y at t0. The fine propagator is called
+ * from several threads at once, so must not share state between calls.
+ *
+ * Coarse coarse : cheap propagator.
+ * Fine fine : accurate propagator.
+ * double startT : start time for the initial conditions.
+ * double finalT : goal time.
+ * StateVector startY : initial conditions.
+ * std::size_t slices : number of time slices.
+ * double tolerance : stop once no slice starting state changes by more than
+ * 	this (in any component) in an iteration.
+ * int maxIterations : most iterations to run.
+ * std::vector<StateVector> & states : set to the state at the start of each
+ * 	slice, and at finalT as the last element.
+ * return : defect and fine work of each iteration.
+ */
+template <typename Coarse, typename Fine, std::size_t N, typename T>
+std::vector<PararealIteration> Parareal(Coarse coarse, Fine fine, double startT, double finalT, const StateVector<N, T> & startY, std::size_t slices, double tolerance, int maxIterations, std::vector<StateVector<N, T> > & states)
+{
+	std::vector<double> times(slices + 1);
+	for (std::size_t n = 0; n != slices; n++)
+		times[n] = startT + (finalT - startT)*n/slices;
+	times[slices] = finalT;
+
+	// Initial guess from the coarse propagator alone. G holds the coarse
+	// result of each slice from its current starting state.
+	std::vector<StateVector<N, T> > G(slices), F(slices);
+	states.assign(slices + 1, startY);
+	for (std::size_t n = 0; n != slices; n++)
+	{
+		G[n] = coarse(times[n], times[n + 1], states[n]);
+		states[n + 1] = G[n];
+	}
+
+	std::vector<PararealIteration> history;
+
+	for (int k = 0; k < maxIterations && (std::size_t)k < slices; k++)
+	{
+		// Slices before k start from exact states, and their fine results
+		// are already in place.
+		std::size_t first = k;
+
+		ParallelFor(slices - first, [&](unsigned worker, std::size_t begin, std::size_t end)
+		{
+			for (std::size_t n = first + begin; n != first + end; n++)
+				F[n] = fine(times[n], times[n + 1], states[n]);
+		});
+
+		// Coarse correction, in sequence.
+		double defect = 0;
+		for (std::size_t n = first; n != slices; n++)
+		{
+			StateVector<N, T> g = coarse(times[n], times[n + 1], states[n]);
+			StateVector<N, T> next = g + F[n] - G[n];
+
+			for (std::size_t i = 0; i != N; i++)
+				defect = std::max(defect, (double)std::abs(next[i] - states[n + 1][i]));
+
+			G[n] = g;
+			states[n + 1] = next;
+		}
+
+		PararealIteration iteration = {defect, slices - first};
+		history.push_back(iteration);
+
+		if (defect <= tolerance)
+			break;
+	}
+
+	return history;
+}
+
+#endif
@@ -11,6 +11,12 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <vector>
+#include <string>
+#include "parallel.h"
+#include "statevector.h"
+#include "extrapolation.h"
+#include "butcher.h"
 
 /**
  * Derivative function provides the value of y' at any point.
@@ -37,16 +43,72 @@ double Analytic(double x);
  * *d : Function which provides the value of y' at arbitrary point.
  * double startY : initial value of y.
  * double startX : initial value of x.
- * int intervals : number of intervals to use.
+ * long long intervals : number of intervals to use.
  * double finalX : value of x to estimate a value of y for.
  * return : Estimated value of y at finalX.
  */
-double Euler(double (*d)(double, double), double startY, double startX, int intervals, double finalX);
+double Euler(double (*d)(double, double), double startY, double startX, long long intervals, double finalX);
+
+/**
+ * Function to solve the same problem with the adaptive Bulirsch-Stoer
+ * extrapolation integrator for a range of error boundaries from 1e-1 to
+ * 1e-13, writing the number of steps and derivative evaluations needed and
+ * the error reached to file, for comparison with Euler's method.
+ *
+ * std::string filename : output filename.
+ * double startY : initial value of y.
+ * double startX : initial value of x.
+ * double finalX : value of x to estimate a value of y for.
+ */
+void ExtrapolationTable(std::string filename, double startY, double startX, double finalX);
+
+/**
+ * Function to solve the same problem with each of the explicit Runge-Kutta
+ * methods of butcher.h, for 10, 20, ..., 640 steps, writing the result, the
+ * error and the observed order of convergence to file. Then checks the error
+ * estimate of each embedded pair over a single step.
+ *
+ * std::string filename : output filename.
+ * double startY : initial value of y.
+ * double startX : initial value of x.
+ * double finalX : value of x to estimate a value of y for.
+ */
+void TableauTable(std::string filename, double startY, double startX, double finalX);
+
+/**
+ * Write the rows of TableauTable for one method.
+ *
+ * FILE * file : output file.
+ * const char * name : name of the method.
+ * double startY : initial value of y.
+ * double startX : initial value of x.
+ * double finalX : value of x to estimate a value of y for.
+ */
+template <typename Method>
+void TableauRows(FILE * file, const char * name, double startY, double startX, double finalX);
+
+/**
+ * Write the embedded error rows of TableauTable for one embedded pair. Takes
+ * a single step from startX for widths 0.1, 0.05, ..., 0.1/32, and compares
+ * the error estimate, the difference y_high - y_low of the two solutions,
+ * with the actual error of y_low. The ratio of the two tends to 1 as the
+ * width shrinks, where y_low is the less accurate. For Heun-Euler from y = 0
+ * it tends to 3/2 instead: y'' = 2 y y' is 0 there, so forward Euler is also
+ * third order accurate over the first step.
+ *
+ * FILE * file : output file.
+ * const char * name : name of the method.
+ * double startY : initial value of y.
+ * double startX : initial value of x.
+ */
+template <typename Method>
+void EmbeddedRows(FILE * file, const char * name, double startY, double startX);
 
 /**
  * Main function which specifies initial conditions, and then asks for maximum
  * number of intervals to use. Then applies euler method, using intervals 1 ->
- * specified amount.
+ * specified amount. Optionally compares with the extrapolation integrator and
+ * the Runge-Kutta methods of butcher.h.
  */
 int main()
 {
@@ -68,27 +130,58 @@ int main()
 		printf("This may take some time...");
 	}
 
+	int extrapolation;
+	printf("Please input 1 to compare with Bulirsch-Stoer extrapolation, 0 to skip: ");
+	while (!(std::cin >> extrapolation) || (extrapolation != 0 && extrapolation != 1))
+	{
+		printf("Enter valid choice: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	int tableau;
+	printf("Please input 1 to compare with the Runge-Kutta tableaux, 0 to skip: ");
+	while (!(std::cin >> tableau) || (tableau != 0 && tableau != 1))
+	{
+		printf("Enter valid choice: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	// Compute answer for each number of intervals, the levels of the sweep
+	// run in parallel (see parallel.h).
+	std::vector<long long> steps = SweepSteps(intervals);
+	std::vector<double> answers = ParallelSweep<double>(steps,
+		[&](unsigned worker, std::size_t level, long long n)
+		{
+			return Euler(Derivative, startY, startX, n, finalX);
+		});
+
 	FILE * file;
 
 	file = fopen("euler_out", "w");
 
 	printf("Writing to file 'euler_out'...\n");
 	
-	double answer;
 	// Actual answer for computing error.
 	double actual = Analytic(finalX);
 
 	fprintf(file, "%-15s%-20s%-20s%-20s\n", "Intervals", "Result", "Analytic Error", "Width");
 	
-	for (int i = 0; i <= intervals*2; i++)
+	for (std::size_t i = 0; i != steps.size(); i++)
 	{
-		// Compute answer, then write to file using intervals = i.
-		answer = Euler(Derivative, startY, startX, (int)std::pow(10, i*0.5), finalX);
-		fprintf(file, "%-15i%-20.15f%-20.15f%-20.15f\n", (int)std::pow(10, i*0.5), answer, std::abs((answer-actual)/actual), (finalX - startX)/std::pow(10, i*0.5));
+		// Write to file using intervals = steps[i].
+		double answer = answers[i];
+		fprintf(file, "%-15lli%-20.15f%-20.15f%-20.15f\n", steps[i], answer, std::abs((answer-actual)/actual), (finalX - startX)/std::pow(10, i*0.5));
 	}
 
 	fclose(file);
 
+	if (extrapolation == 1)
+		ExtrapolationTable("bs_out", startY, startX, finalX);
+	if (tableau == 1)
+		TableauTable("tableau_out", startY, startX, finalX);
+
 	printf("Done!\n");
 
 	return 0;
@@ -105,7 +198,7 @@ double Analytic(double x)
 	return std::tan(x);
 }
 
-double Euler(double (*d)(double, double), double startY, double startX, int intervals, double finalX)
+double Euler(double (*d)(double, double), double startY, double startX, long long intervals, double finalX)
 {
 	double h = (finalX-startX)/intervals;
 
@@ -116,7 +209,7 @@ double Euler(double (*d)(double, double), double startY, double startX, int inte
 	x = startX;
 
 	// Invariant: We have moved to point x = startX + i*h.
-	for (int i = 0; i != intervals; i++)
+	for (long long i = 0; i != intervals; i++)
 	{
 		// Apply euler's method.
 		y1 = y0 + h*(*d)(x, y0);
@@ -127,3 +220,144 @@ double Euler(double (*d)(double, double), double startY, double startX, int inte
 
 	return y0;
 }
+
+void ExtrapolationTable(std::string filename, double startY, double startX, double finalX)
+{
+	FILE * file;
+
+	file = fopen(filename.c_str(), "w");
+
+	printf("Writing to file '%s'...\n", filename.c_str());
+
+	double actual = Analytic(finalX);
+
+	// Single component form of the derivative for the integrator.
+	auto d = [](double x, const StateVector<1> & y)
+	{
+		StateVector<1> temp;
+		temp[0] = Derivative(x, y[0]);
+		return temp;
+	};
+
+	fprintf(file, "%-15s%-15s%-15s%-15s%-20s%-20s\n", "Tolerance", "Steps", "Rejected", "Evaluations", "Result", "Analytic Error");
+
+	for (int i = 1; i <= 13; i++)
+	{
+		double tolerance = std::pow(10, -i);
+
+		BulirschStoer<1, double, decltype(d)> solver(d, tolerance, tolerance);
+
+		double x = startX;
+		double h = (finalX - startX)/10;
+		StateVector<1> y;
+		y[0] = startY;
+
+		while (x < finalX)
+		{
+			if (solver.Apply(x, finalX, h, y) != 0)
+			{
+				printf("Critical failure at tolerance %g.\n", tolerance);
+				break;
+			}
+		}
+
+		fprintf(file, "%-15.0e%-15lli%-15lli%-15lli%-20.15f%-20.3e\n", tolerance, solver.accepted, solver.rejected, solver.evaluations, y[0], std::abs((y[0]-actual)/actual));
+	}
+
+	fclose(file);
+}
+
+void TableauTable(std::string filename, double startY, double startX, double finalX)
+{
+	FILE * file;
+
+	file = fopen(filename.c_str(), "w");
+
+	printf("Writing to file '%s'...\n", filename.c_str());
+
+	fprintf(file, "%-20s%-15s%-15s%-20s%-20s%-10s\n", "Method", "Intervals", "Evaluations", "Result", "Analytic Error", "Order");
+
+	TableauRows<EulerMethod>(file, "Euler", startY, startX, finalX);
+	TableauRows<Midpoint>(file, "Midpoint", startY, startX, finalX);
+	TableauRows<Heun>(file, "Heun", startY, startX, finalX);
+	TableauRows<Ralston>(file, "Ralston", startY, startX, finalX);
+	TableauRows<KuttaThird>(file, "Kutta3", startY, startX, finalX);
+	TableauRows<SSPThird>(file, "SSPRK3", startY, startX, finalX);
+	TableauRows<ClassicalFourth>(file, "RK4", startY, startX, finalX);
+	TableauRows<ThreeEighths>(file, "3/8-rule", startY, startX, finalX);
+	TableauRows<BogackiShampine>(file, "Bogacki-Shampine", startY, startX, finalX);
+	TableauRows<CashKarp>(file, "Cash-Karp", startY, startX, finalX);
+
+	fprintf(file, "\n%-20s%-15s%-20s%-20s%-10s\n", "Embedded Pair", "Width", "Estimate", "Low Order Error", "Ratio");
+
+	EmbeddedRows<HeunEuler>(file, "Heun-Euler", startY, startX);
+	EmbeddedRows<BogackiShampine>(file, "Bogacki-Shampine", startY, startX);
+	EmbeddedRows<CashKarp>(file, "Cash-Karp", startY, startX);
+
+	fclose(file);
+}
+
+template <typename Method>
+void TableauRows(FILE * file, const char * name, double startY, double startX, double finalX)
+{
+	double actual = Analytic(finalX);
+
+	// Single component form of the derivative, inlined into the stages.
+	auto d = [](double x, const StateVector<1> & y)
+	{
+		StateVector<1> temp;
+		temp[0] = Derivative(x, y[0]);
+		return temp;
+	};
+
+	double previous = 0;
+
+	for (long long n = 10; n <= 640; n *= 2)
+	{
+		ExplicitRungeKutta<Method, 1, double, decltype(d)> stepper(d);
+
+		double h = (finalX - startX)/n;
+		StateVector<1> y;
+		y[0] = startY;
+
+		for (long long i = 0; i != n; i++)
+			stepper.Step(startX + i*h, h, y);
+
+		double error = std::abs((y[0]-actual)/actual);
+
+		// Observed order from the error with half as many steps.
+		if (previous > 0)
+			fprintf(file, "%-20s%-15lli%-15lli%-20.15f%-20.3e%-10.2f\n", name, n, stepper.evaluations, y[0], error, std::log2(previous/error));
+		else
+			fprintf(file, "%-20s%-15lli%-15lli%-20.15f%-20.3e%-10s\n", name, n, stepper.evaluations, y[0], error, "");
+
+		previous = error;
+	}
+}
+
+template <typename Method>
+void EmbeddedRows(FILE * file, const char * name, double startY, double startX)
+{
+	auto d = [](double x, const StateVector<1> & y)
+	{
+		StateVector<1> temp;
+		temp[0] = Derivative(x, y[0]);
+		return temp;
+	};
+
+	ExplicitRungeKutta<Method, 1, double, decltype(d)> stepper(d);
+
+	for (double h = 0.1; h > 0.1/64; h /= 2)
+	{
+		StateVector<1> y, error;
+		y[0] = startY;
+
+		stepper.Step(startX, h, y, error);
+
+		// The error estimate is y_high - y_low.
+		double low = y[0] - error[0];
+		double actual = std::abs(low - Analytic(startX + h));
+
+		fprintf(file, "%-20s%-15.6f%-20.3e%-20.3e%-10.4f\n", name, h, std::abs(error[0]), actual, std::abs(error[0])/actual);
+	}
+}
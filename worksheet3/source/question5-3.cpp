@@ -14,6 +14,7 @@
 #include <iostream>
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_odeiv2.h>
+#include "../../common/dual.h"
 
 /**
  * Function that gives the derivatives of both v and x. See report for details.
@@ -30,7 +31,23 @@
 int Function(double t, const double y[], double f[], void * params);
 
 /**
- * Jacobian function pointer required by GSL routines, but unused.
+ * Right hand side of the system, shared by Function and Jacobian. Templated
+ * so that it can be evaluated on dual numbers.
+ *
+ * const T y[] : v and x.
+ * T f[] : filled with v' and x'.
+ */
+template <typename T>
+void Oscillator(const T y[], T f[])
+{
+	f[0] = -y[1];
+	f[1] = y[0];
+}
+
+/**
+ * Jacobian of Function, df_i/dy_j stored row major in dfdy, and df/dt in
+ * dfdt. Used by the implicit GSL steppers (bsimp, msbdf, rk*imp). Found
+ * exactly by evaluating Oscillator on dual numbers.
  */
 int Jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params);
 
@@ -127,13 +144,17 @@ int main()
 
 int Function(double t, const double y[], double f[], void * params)
 {
-	f[0] = -y[1];
-	f[1] = y[0];
+	Oscillator(y, f);
 	return GSL_SUCCESS;
 }
 
 int Jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params)
 {
+	double f[2];
+	DualJacobian<2, 2>(Oscillator<Dual<double, 2> >, y, f, dfdy);
+	// The system doesn't depend on time explicitly.
+	dfdt[0] = 0;
+	dfdt[1] = 0;
 	return GSL_SUCCESS;
 }
 
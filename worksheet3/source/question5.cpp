@@ -3,8 +3,8 @@
  *
  * Source code for a program to estimate the solution to a second order 
  * differential equation (split into two first order ODEs) using the
- * Runge-Kutta method. Includes a basic vector type for simple required
- * vector operations.
+ * Runge-Kutta method. Uses the StateVector type (statevector.h) for the
+ * required vector operations.
  *
  * GSL version 1.16
  */
@@ -12,81 +12,130 @@
 #include <cstdio>
 #include <cmath>
 #include <iostream>
+#include <vector>
+#include <string>
+#include <limits>
+#include <memory>
+#include <chrono>
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_odeiv2.h>
-#include <iostream>
+#include "statevector.h"
+#include "rungekutta.h"
+#include "dormandprince.h"
+#include "symplectic.h"
+#include "parallel.h"
+#include "dense.h"
+#include "events.h"
+#include "statistics.h"
+#include "checkpoint.h"
+#include "integrate.h"
+#include "asyncwriter.h"
+#include "trajectory.h"
+#include "parareal.h"
+#include "sensitivity.h"
+#include "decimation.h"
+#include "rasterizer.h"
+#include "../../common/dual.h"
 
 /**
- * Vector struct, useful for storing results and intermediate answers. Used
+ * Vector type, useful for storing results and intermediate answers. Used
  * throughout this code as it is more appropriate than both std::vector<> and
  * the array type. (Neither have scalar multiplication or addition which is
- * invaluable.)
+ * invaluable.) See statevector.h, here vec[0] = v and vec[1] = x.
+ */
+typedef StateVector<2> Vector;
+
+/**
+ * Derivative (below) as a function object, to instantiate the native solvers
+ * with. Its type names the function, unlike a function pointer, so the
+ * solvers' stages can inline it.
  */
-struct Vector
+struct DerivativeFunction
 {
-	// Two dimensional vector with two double members.
-	// Although there is no reason these members couldn't refer to other
-	// things throughout this source code vec.one = v and vec.two = x.
-	double one;
-	double two;
+	Vector operator()(double t, const Vector & y) const;
+};
 
-	Vector() 
-	{}
+// Number of parameters of the GSL form of the problem, v' = -w^2 x - c v,
+// x' = v: the frequency squared w^2 and the damping c.
+const std::size_t parameterCount = 2;
 
-	Vector(double first, double second) :
-		one(first), two(second)
-	{}
+// Parameters of the problem as set, passed to Function and Jacobian by the
+// GSL routines. The analytic solution and error estimates assume these.
+double parameters[parameterCount] = {1, 0};
 
-	Vector(const double arr[]) :
-		one(arr[0]), two(arr[1])
-	{}
+/**
+ * One row of a phase plot output file: interval (or output point) number,
+ * time, v, x, step width and error estimate.
+ */
+struct PhaseRow
+{
+	long long interval;
+	double t;
+	double v;
+	double x;
+	double width;
+	double error;
+};
 
-	// Defining basic arithmetic operations.
-	Vector operator+(Vector const& other)
-	{
-		Vector temp;
-		temp.one = one + other.one;
-		temp.two = two + other.two;
-		return temp;
-	}
-	Vector operator-(Vector const& other)
-	{
-		Vector temp;
-		temp.one = one - other.one;
-		temp.two = two - other.two;
-		return temp;
-	}
+/**
+ * Write a phase plot row to file, in the column format of every phase output.
+ */
+void WritePhaseRow(FILE * file, const PhaseRow & row);
 
-	void ArrayConvert(double out[])
-	{
-		out[0] = one;
-		out[1] = two;
-		return;
-	}
+// Writer for phase plot rows, formatting them on a background thread (see
+// asyncwriter.h).
+typedef AsyncWriter<PhaseRow, void (*)(FILE *, const PhaseRow &)> PhaseWriter;
+
+// Format of phase plot output files.
+enum OutputFormat
+{
+	TextOutput,
+	BinaryOutput,
+	CompressedOutput,
+	DensityOutput
 };
 
-// Defining scalar multiplication.
-Vector operator*(Vector const& lhs, double rhs)
-{ 
-	Vector temp;
-	temp.one = lhs.one * rhs;
-	temp.two = lhs.two * rhs;
-	return temp;
-}
-Vector operator*(double lhs, Vector const& rhs)
-{ 
-	Vector temp;
-	temp.one = lhs * rhs.one;
-	temp.two = lhs * rhs.two;
-	return temp;
-}
-Vector operator/(Vector const& lhs, double rhs)
-{ 
-	Vector temp;
-	temp.one = lhs.one / rhs;
-	temp.two = lhs.two / rhs;
-	return temp;
-}
+/**
+ * Output file of a phase plot. Text files are written on a background thread
+ * through PhaseWriter. Binary files are trajectory files (see trajectory.h),
+ * with time as the first column and the interval number stored as a double,
+ * and may be compressed (see compression.h). Density output keeps no rows at
+ * all, only a histogram of the states in phase space written as a PGM image
+ * (see rasterizer.h), so even the longest runs need little memory or disk.
+ */
+class PhaseOutput
+{
+public:
+	/**
+	 * std::string filename : output filename.
+	 * OutputFormat format : text, binary, compressed binary or density
+	 * 	image. The size of the image is asked for here.
+	 * std::string method : name of the integration method, for the header
+	 * 	of a binary file.
+	 * double parameter : step width or tolerance of the method.
+	 */
+	PhaseOutput(std::string filename, OutputFormat format, std::string method, double parameter);
+
+	void Write(const PhaseRow & row);
+
+	/**
+	 * Finish writing and close the file, reporting if the solver had to wait
+	 * for the text writer. The density image is written here.
+	 */
+	void Close();
+
+private:
+	std::string filename;
+	FILE * file;
+	std::unique_ptr<PhaseWriter> text;
+	std::unique_ptr<TrajectoryWriter> binary;
+	// Image size in pixels for density output, 0 otherwise.
+	std::size_t pixels;
+	// Made on the first row, which sets the range of the image.
+	std::unique_ptr<PhaseHistogram> density;
+	// Time of the last row binned.
+	double last;
+};
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //
@@ -101,39 +150,25 @@ Vector operator/(Vector const& lhs, double rhs)
  * Vector y : v and x values to evaluate derivative at.
  * return : v' and x' evaluated at t and y.
  */
-Vector Derivative(double t, Vector y);
+Vector Derivative(double t, const Vector & y);
 
 /**
- * Analytic returns the analytic solution of the problem at time t.
+ * Acceleration gives v' in terms of x alone, the form of the problem used by
+ * the symplectic integrators (see symplectic.h) where q = x and p = v.
  *
- * double t : time to evaluate solution.
- * return : value of v and x at t.
+ * double t : Time to evaluate acceleration.
+ * StateVector<1> x : position to evaluate acceleration at.
+ * return : v' evaluated at t and x.
  */
-Vector Analytic(double t);
+StateVector<1> Acceleration(double t, const StateVector<1> & x);
 
 /**
- * Function that performs one step of the second order Runge-Kutta method.
- *
- * *d : derivative function for 2 dimensional problem.
- * Vector y0 : value of y at start of step.
- * double t0 : value of t at start of step.
- * double h : width of step.
- * return : estimate value of y at t0 + h.
- */
-Vector RungeKuttaStep(Vector (*d)(double, Vector), Vector y0, double t0, double h);
-
-/**
- * Function that applies second order Runge-Kutta using specified derivative
- * function. Uses intervals number of intervals.
+ * Analytic returns the analytic solution of the problem at time t.
  *
- * *d : derivative function for 2 dimensional problem.
- * Vector startY : initial conditions for the solution.
- * double startT : start time for initial conditions.
- * int intervals : number of intervals to use in rk method.
- * double finalT : goal time.
- * return : estimate for v & x at time finalT
+ * double t : time to evaluate solution.
+ * return : value of v and x at t.
  */
-Vector RungeKuttaSecond(Vector (*d)(double, Vector), Vector startY, double startT, int intervals, double finalT);
+Vector Analytic(double t);
 
 /**
  * RungeKuttaError runs the Runge-Kutta method maxIntervals number of times,
@@ -151,15 +186,23 @@ void RungeKuttaError(std::string filename, Vector startY, double startT, int max
 /**
  * RungeKuttaPhase outputs the results for the Runge-Kutta method to a file
  * after each single step of the algorithm. This is in order to produce a
- * phase plot of the solution.
+ * phase plot of the solution. Alternatively the solution can be sampled at
+ * evenly spaced output times using Hermite interpolation (see dense.h), so
+ * output resolution doesn't depend on the number of intervals. Steps can also
+ * be decimated as they are written (see decimation.h).
  *
  * std::string filename : output filename.
  * Vector startY : initial conditions for the solution.
  * double startT : start time for the intial conditions.
  * int maxIntervals : highest interval number to use.
  * double finalT : goal time.
+ * long long points : number of output times, 0 to output every step.
+ * OutputFormat format : text, a binary trajectory file, optionally
+ * 	compressed, or a density image.
+ * DecimationPolicy policy : which steps to write when points is 0.
+ * double decimation : k, error bound or sample size for the policy.
  */
-void RungeKuttaPhase(std::string filename, Vector startY, double startT, int intervals, double finalT);
+void RungeKuttaPhase(std::string filename, Vector startY, double startT, int intervals, double finalT, long long points, OutputFormat format, DecimationPolicy policy, double decimation);
 
 /**
  * Function to estimate error using conservation of energy, see report for
@@ -171,6 +214,117 @@ void RungeKuttaPhase(std::string filename, Vector startY, double startT, int int
  */
 double ErrorEstimate(const Vector & yInitial, const Vector & y);
 
+/**
+ * AdaptiveDormandPrincePhase uses the native Dormand-Prince 5(4) integrator
+ * (see dormandprince.h) with adaptive step size. Outputs after each accepted
+ * step, for a phase plot, or samples the solution at evenly spaced output
+ * times using the integrator's dense output. Reports the number of accepted
+ * and rejected steps and derivative evaluations.
+ *
+ * std::string filename : output filename.
+ * Vector startY : initial conditions for the solution.
+ * double startT : start time for the initial conditions.
+ * double finalT : goal time.
+ * long long points : number of output times, 0 to output every step.
+ * OutputFormat format : text, a binary trajectory file, optionally
+ * 	compressed, or a density image.
+ */
+void AdaptiveDormandPrincePhase(std::string filename, Vector startY, double startT, double finalT, long long points, OutputFormat format);
+
+/**
+ * SymplecticPhase uses a symplectic integrator (see symplectic.h) with the
+ * specified number of intervals, asking which order of method to use. Writes
+ * the state of the system after each step, in order to produce a phase plot.
+ * The energy error estimate stays bounded, unlike for Runge-Kutta.
+ *
+ * std::string filename : output filename.
+ * Vector startY : initial conditions for the solution.
+ * double startT : start time for the intial conditions.
+ * int intervals : interval number to use.
+ * double finalT : goal time.
+ * OutputFormat format : text, a binary trajectory file, optionally
+ * 	compressed, or a density image.
+ */
+void SymplecticPhase(std::string filename, Vector startY, double startT, int intervals, double finalT, OutputFormat format);
+
+/**
+ * EventPhase integrates with the Dormand-Prince integrator and writes only
+ * events to file: zero crossings of x and turning points (v = 0), located
+ * using the dense output (see events.h). The period of the oscillator is
+ * found from successive upward crossings of x.
+ *
+ * std::string filename : output filename.
+ * Vector startY : initial conditions for the solution.
+ * double startT : start time for the initial conditions.
+ * double finalT : goal time.
+ */
+void EventPhase(std::string filename, Vector startY, double startT, double finalT);
+
+/**
+ * CachedQuery finds the state at finalT with second order Runge-Kutta or
+ * Dormand-Prince, asking which along with the step width or tolerance. The
+ * integration resumes from the latest cached checkpoint of the same
+ * trajectory before finalT (see checkpoint.h), and adds new checkpoints as it
+ * goes, so repeated queries with growing goal times only integrate the
+ * difference.
+ *
+ * TrajectoryCache & cache : checkpoints, kept between queries.
+ * Vector startY : initial conditions for the solution.
+ * double startT : start time for the initial conditions.
+ * double finalT : goal time.
+ */
+void CachedQuery(TrajectoryCache<2> & cache, Vector startY, double startT, double finalT);
+
+/**
+ * ExportPhase reads the rows of a binary phase plot file within a time range
+ * and writes them to a text file in the usual phase plot format. The text
+ * file is named after the binary one without its ".traj" extension.
+ *
+ * std::string filename : binary phase plot file.
+ * double t0, t1 : time range to export.
+ */
+void ExportPhase(std::string filename, double t0, double t1);
+
+/**
+ * PararealPhase integrates to finalT with Parareal (see parareal.h), using
+ * second order Runge-Kutta with a few large steps per time slice as the
+ * coarse propagator and fourth order Runge-Kutta (GSL) with many small steps
+ * as the fine one. The same fine integration is also run serially for
+ * comparison. Writes the defect of each iteration to file, followed by the
+ * iteration count, both run times and the speedup.
+ *
+ * std::string filename : output filename.
+ * Vector startY : initial conditions for the solution.
+ * double startT : start time for the initial conditions.
+ * double finalT : goal time.
+ */
+void PararealPhase(std::string filename, Vector startY, double startT, double finalT);
+
+/**
+ * SensitivityPhase integrates the problem with chosen parameters w^2 and c
+ * together with the sensitivities of v and x to both (see sensitivity.h),
+ * writing them to file after each accepted step. The sensitivities at finalT
+ * are then checked against central finite differences from 2 P further
+ * Dormand-Prince runs with each parameter perturbed, and the work of the two
+ * approaches compared.
+ *
+ * std::string filename : output filename.
+ * Vector startY : initial conditions for the solution.
+ * double startT : start time for the initial conditions.
+ * double finalT : goal time.
+ */
+void SensitivityPhase(std::string filename, Vector startY, double startT, double finalT);
+
+/**
+ * Event function for zero crossings of x.
+ */
+double CrossingEvent(double t, const Vector & y);
+
+/**
+ * Event function for turning points of x, where v = 0.
+ */
+double TurningEvent(double t, const Vector & y);
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //
 // GSL Routine Functions.
@@ -201,14 +355,32 @@ double AnalyticX(double t);
  * double y[] : Array corresponding to v and x (y[0] = v, y[1] = x.
  * double f[] : Array to store the values of derivatives after function has
  * 		been called (f[0] = v', f[1] = x').
- * void * params : Parameters for the function required by GSL, unused here.
+ * void * params : Points to the parameterCount parameters, w^2 and c.
  * return : Status code, GSL_SUCCESS indicating success. As nothing complicated
  * 		happens we return this every time.
  */
 int Function(double t, const double y[], double f[], void * params);
 
 /**
- * Jacobian function pointer required by GSL routines, but unused.
+ * Right hand side of the system, shared by Function, Jacobian and the
+ * sensitivity analysis. Templated so that it can be evaluated on dual
+ * numbers, in the state or the parameters.
+ *
+ * const T y[] : v and x.
+ * const T p[] : w^2 and c.
+ * T f[] : filled with v' and x'.
+ */
+template <typename T>
+void Oscillator(const T y[], const T p[], T f[])
+{
+	f[0] = -p[0] * y[1] - p[1] * y[0];
+	f[1] = y[0];
+}
+
+/**
+ * Jacobian of Function, df_i/dy_j stored row major in dfdy, and df/dt in
+ * dfdt. Used by the implicit GSL steppers (bsimp, msbdf, rk*imp). Found
+ * exactly by evaluating Oscillator on dual numbers.
  */
 int Jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params);
 
@@ -228,15 +400,18 @@ void GSLError(std::string filename, Vector startY, double startT, int maxInterva
 /**
  * GSLPhase uses the GSL Runge-Kutta method with specified number of intervals.
  * Writes the state of the system to file after each step, in order to produce
- * a phase plot.
+ * a phase plot, or at evenly spaced output times using Hermite interpolation.
  *
  * std::string filename : output filename.
  * Vector startY : initial conditions for the solution.
  * double startT : start time for the initial conditions.
  * int maxIntervals : interval number to use.
  * double finalT : goal time.
+ * long long points : number of output times, 0 to output every step.
+ * OutputFormat format : text, a binary trajectory file, optionally
+ * 	compressed, or a density image.
  */
-void GSLPhase(std::string filename, Vector startY, double startT, int intervals, double finalT);
+void GSLPhase(std::string filename, Vector startY, double startT, int intervals, double finalT, long long points, OutputFormat format);
 
 /**
  * Function to estimate the error using conservation of energy. See report for
@@ -250,14 +425,18 @@ double ErrorEstimate(const double yInitial[], const double y[]);
 
 /**
  * This function uses the GSL adaptive ordinary integration procedure. Outputs
- * after each stage, for a phase plot.
+ * after each stage, for a phase plot, or at evenly spaced output times using
+ * Hermite interpolation.
  *
  * std::string filename : output filename.
  * Vector startY : initial conditions for the solution.
  * double startT : start time for the initial conditions.
  * double finalT : goal time.
+ * long long points : number of output times, 0 to output every step.
+ * OutputFormat format : text, a binary trajectory file, optionally
+ * 	compressed, or a density image.
  */
-void AdaptiveGSLPhase(std::string filename, Vector startY, double startT, double finalT);
+void AdaptiveGSLPhase(std::string filename, Vector startY, double startT, double finalT, long long points, OutputFormat format);
 
 /**
  * Main method requests goal time and max no. of intervals then applies rk
@@ -269,6 +448,10 @@ int main()
 {
 	bool running = true;
 
+	// Checkpoints of earlier long time queries, in this run and previous ones.
+	TrajectoryCache<2> cache;
+	cache.Load("trajectory_cache");
+
 	printf("\n#############################################\n");
 	printf("#                                           #\n");
 	printf("# Ordinary Differential Equation Calculator #\n");
@@ -279,8 +462,8 @@ int main()
 	{
 		// Initial conditions.
 		Vector startY;
-		startY.one = 1;
-		startY.two = 0;
+		startY[0] = 1;
+		startY[1] = 0;
 		double startT = 0;
 	
 		printf("\n(1) Second order Runge-Kutta error analysis.\n");
@@ -288,12 +471,19 @@ int main()
 		printf("(3) Fourth order Runge-Kutta error analysis (GSL).\n");
 		printf("(4) Fourth order Runge-Kutta phase plot (GSL).\n");
 		printf("(5) Adaptive fourth order Runge-Kutta phase plot (GSL).\n");
-		printf("(6) Quit.\n");
+		printf("(6) Adaptive fifth order Dormand-Prince phase plot.\n");
+		printf("(7) Symplectic phase plot.\n");
+		printf("(8) Event detection (crossings, turning points and period).\n");
+		printf("(9) Long time query with cached checkpoints.\n");
+		printf("(10) Export binary phase plot to text.\n");
+		printf("(11) Parareal parallel in time integration.\n");
+		printf("(12) Parameter sensitivity analysis.\n");
+		printf("(13) Quit.\n");
 
 		int choice;
 		printf("Please enter a choice: ");
 
-		while (!(std::cin >> choice) || choice < 1 || choice > 6)
+		while (!(std::cin >> choice) || choice < 1 || choice > 13)
 		{
 			printf("Enter valid choice: ");
 			std::cin.clear();
@@ -301,7 +491,20 @@ int main()
 		}
 
 		// Exit.
-		if (choice == 6) break;
+		if (choice == 13) break;
+
+		if (choice == 10)
+		{
+			std::string filename;
+			double t0, t1;
+			printf("\nPlease input binary file name: ");
+			std::cin >> filename;
+			printf("Please input start and end time: ");
+			std::cin >> t0 >> t1;
+			ExportPhase(filename, t0, t1);
+			printf("Done!\n");
+			continue;
+		}
 	
 		double finalT;
 		printf("\nPlease input goal time: ");
@@ -314,12 +517,64 @@ int main()
 			std::cin >> intervals;
 		}
 		// No need for interval number with adaptive method.
-		else if (choice == 2 || choice == 4)
+		else if (choice == 2 || choice == 4 || choice == 7)
 		{
 			printf("Please input no. of intervals: ");
 			std::cin >> intervals;
 		}
 
+		// Phase plots can be sampled independently of the step size.
+		long long points = 0;
+		if (choice == 2 || choice == 4 || choice == 5 || choice == 6)
+		{
+			printf("Please input no. of output points (0 for every step): ");
+			std::cin >> points;
+		}
+
+		// Long phase plots can be thinned out as they are written.
+		DecimationPolicy policy = KeepAll;
+		double decimation = 0;
+		if (choice == 2 && points == 0)
+		{
+			int decimate;
+			printf("Please input output decimation (0 every step, 1 every k-th step, 2 on change, 3 reservoir sample): ");
+			while (!(std::cin >> decimate) || decimate < 0 || decimate > 3)
+			{
+				printf("Enter valid decimation: ");
+				std::cin.clear();
+				std::cin.ignore();
+			}
+			policy = (DecimationPolicy)decimate;
+
+			if (policy != KeepAll)
+			{
+				printf("Please input k, error bound or sample size: ");
+				std::cin >> decimation;
+			}
+		}
+
+		// Phase plots can be written as binary trajectory files, named with a
+		// ".traj" extension, and exported to text later (choice 10), or binned
+		// into a density image as they run.
+		OutputFormat format = TextOutput;
+		std::string extension;
+		if (choice == 2 || choice == 4 || choice == 5 || choice == 6 || choice == 7)
+		{
+			int binary;
+			printf("Please input output format (0 text, 1 binary, 2 compressed binary, 3 density image): ");
+			std::cin >> binary;
+			if (binary == 1 || binary == 2)
+			{
+				format = binary == 1 ? BinaryOutput : CompressedOutput;
+				extension = ".traj";
+			}
+			else if (binary == 3)
+			{
+				format = DensityOutput;
+				extension = ".pgm";
+			}
+		}
+
 		switch (choice)
 		{
 			// Run the function corresponding to the menu choice.
@@ -327,16 +582,35 @@ int main()
 				RungeKuttaError("rk_out", startY, startT, intervals, finalT);
 				break;
 			case 2:
-				RungeKuttaPhase("phase_rk_out", startY, startT, intervals, finalT);
+				RungeKuttaPhase("phase_rk_out" + extension, startY, startT, intervals, finalT, points, format, policy, decimation);
 				break;
 			case 3:
 				GSLError("gsl_out", startY, startT, intervals, finalT);
 				break;
 			case 4:
-				GSLPhase("phase_gsl_out", startY, startT, intervals, finalT);
+				GSLPhase("phase_gsl_out" + extension, startY, startT, intervals, finalT, points, format);
 				break;
 			case 5:
-				AdaptiveGSLPhase("adap_phase_gsl_out", startY, startT, finalT);
+				AdaptiveGSLPhase("adap_phase_gsl_out" + extension, startY, startT, finalT, points, format);
+				break;
+			case 6:
+				AdaptiveDormandPrincePhase("adap_phase_dp_out" + extension, startY, startT, finalT, points, format);
+				break;
+			case 7:
+				SymplecticPhase("phase_symp_out" + extension, startY, startT, intervals, finalT, format);
+				break;
+			case 8:
+				EventPhase("events_out", startY, startT, finalT);
+				break;
+			case 9:
+				CachedQuery(cache, startY, startT, finalT);
+				cache.Save("trajectory_cache");
+				break;
+			case 11:
+				PararealPhase("parareal_out", startY, startT, finalT);
+				break;
+			case 12:
+				SensitivityPhase("sensitivity_out", startY, startT, finalT);
 				break;
 		}
 
@@ -346,61 +620,46 @@ int main()
 	return 0;
 }
 
-Vector Derivative(double t, Vector y)
+Vector Derivative(double t, const Vector & y)
 {
 	Vector temp;
-	temp.one = -y.two;
-	temp.two = y.one;
+	temp[0] = -y[1];
+	temp[1] = y[0];
 	return temp;
 }
 
-Vector Analytic(double t)
+Vector DerivativeFunction::operator()(double t, const Vector & y) const
 {
-	// See report for details of the analytic solution.
-	Vector temp;
-	temp.one = std::cos(t);
-	temp.two = std::sin(t);
-	return temp;
+	return Derivative(t, y);
 }
 
-Vector RungeKuttaStep(Vector (*d)(double, Vector), Vector y0, double t0, double h)
+StateVector<1> Acceleration(double t, const StateVector<1> & x)
 {
-	Vector k1, k2, y1;
-
-	// Intermediate r-k values.
-	k1 = (h * (*d)(t0, y0));
-	k2 = (h * (*d)(t0 + h/2, y0 + k1/2.0));
-
-	y1 = y0 + k2;
-
-	return y1;
+	StateVector<1> temp;
+	temp[0] = -x[0];
+	return temp;
 }
 
-Vector RungeKuttaSecond(Vector (*d)(double, Vector), Vector startY, double startT, int intervals, double finalT)
+Vector Analytic(double t)
 {
-	double h = (finalT - startT)/intervals;		
-	
-	// Temporary variables.
-	Vector y;
-	double t;
-
-	y = startY;
-	t = startT;
-
-	// Invariant: we have moved to time t = startT + i*h.
-	for (int i = 0; i != intervals; i++)
-	{
-		y = RungeKuttaStep(d, y, t, h);
-		t += h;
-	}
-
-	return y;
+	// See report for details of the analytic solution.
+	Vector temp;
+	temp[0] = std::cos(t);
+	temp[1] = std::sin(t);
+	return temp;
 }
 
 void RungeKuttaError(std::string filename, Vector startY, double startT, int maxIntervals, double finalT)
 {
 	Vector actual = Analytic(finalT);
-	Vector answer;
+
+	// Apply rk with each number of steps, the levels run in parallel.
+	std::vector<long long> steps = SweepSteps(maxIntervals);
+	std::vector<Vector> answers = ParallelSweep<Vector>(steps,
+		[&](unsigned worker, std::size_t level, long long n)
+		{
+			return RungeKuttaSecond(DerivativeFunction(), startY, startT, n, finalT);
+		});
 
 	FILE * file = fopen(filename.c_str(), "w");
 	
@@ -408,14 +667,13 @@ void RungeKuttaError(std::string filename, Vector startY, double startT, int max
 	fprintf(file, "%-20s%-20s%-20s%-20s%-20s%-20s\n",
 		"Intervals", "Result V", "Result X", "Analytic Error V", "Analytic Error X", "Width");
 	
-	for (int i = 0; i <= maxIntervals*2; i++)
-	{
-		// Apply rk i times.
-		answer = RungeKuttaSecond(Derivative, startY, startT, (int)std::pow(10, i*0.5), finalT);
-		fprintf(file, "%-20i%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", 
-		(int)std::pow(10, i*0.5), answer.one, answer.two, 
-		std::abs((answer.one-actual.one)/actual.one),
-		std::abs((answer.two-actual.two)/actual.two),
+	for (std::size_t i = 0; i != steps.size(); i++)
+	{
+		Vector & answer = answers[i];
+		fprintf(file, "%-20lli%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", 
+		steps[i], answer[0], answer[1], 
+		std::abs((answer[0]-actual[0])/actual[0]),
+		std::abs((answer[1]-actual[1])/actual[1]),
 		(finalT - startT)/std::pow(10, i*0.5));
 	}
 
@@ -424,39 +682,726 @@ void RungeKuttaError(std::string filename, Vector startY, double startT, int max
 	return;
 }
 
-void RungeKuttaPhase(std::string filename, Vector startY, double startT, int intervals, double finalT)
+void RungeKuttaPhase(std::string filename, Vector startY, double startT, int intervals, double finalT, long long points, OutputFormat format, DecimationPolicy policy, double decimation)
 {
-	FILE * file = fopen(filename.c_str() ,"w");
+	// Initial conditions.
+	double t = startT;
+	double h = (finalT - startT)/intervals;
+	Vector y = startY;
 
 	printf("Writing to file %s...\n", filename.c_str());
 
+	PhaseOutput output(filename, format, "rk2", h);
+
+	if (points > 0)
+	{
+		// Sample on the output grid, interpolating within each step.
+		OutputGrid grid(startT, finalT, points);
+		Vector f0 = Derivative(t, y);
+
+		for (int i = 0; i != intervals; i++)
+		{
+			Vector y1 = RungeKuttaStep(DerivativeFunction(), y, t, h);
+			double t1 = (i + 1 == intervals) ? finalT : t + h;
+			Vector f1 = Derivative(t1, y1);
+
+			while (grid.Pending(t1))
+			{
+				Vector sample = HermiteInterpolate(t, y, f0, t1, y1, f1, grid.Time());
+				output.Write(PhaseRow{grid.Index(), grid.Time(), sample[0], sample[1], h, ErrorEstimate(startY, sample)});
+				grid.Advance();
+			}
+
+			y = y1;
+			f0 = f1;
+			t = t1;
+		}
+	}
+	else
+	{
+		Decimator<2, PhaseRow> decimator(policy, decimation);
+		auto write = [&output](const PhaseRow & row) { output.Write(row); };
+
+		for (int i = 0; i != intervals; i++)
+		{
+			// Apply rk 1 time.
+			decimator.Offer(t, y, PhaseRow{i, t, y[0], y[1], h, ErrorEstimate(startY, y)}, write);
+			y = RungeKuttaStep(DerivativeFunction(), y, t, h);
+			// Increment t.
+			t += h;
+		}
+
+		decimator.Finish(write);
+
+		printf("Wrote %lli of %lli steps.\n", decimator.written, decimator.offered);
+	}
+
+	output.Close();
+
+	return;
+}
+
+void WritePhaseRow(FILE * file, const PhaseRow & row)
+{
+	fprintf(file, "%-10lli%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", row.interval, row.t, row.v, row.x, row.width, row.error);
+}
+
+PhaseOutput::PhaseOutput(std::string filename, OutputFormat format, std::string method, double parameter) :
+	filename(filename), file(0), pixels(0), last(0)
+{
+	if (format == DensityOutput)
+	{
+		long long size = 0;
+		printf("Please input size of density image in pixels: ");
+		while (!(std::cin >> size) || size < 1)
+		{
+			printf("Enter valid size: ");
+			std::cin.clear();
+			std::cin.ignore();
+		}
+		pixels = size;
+		return;
+	}
+
+	if (format != TextOutput)
+	{
+		const char * names[] = {"Time", "Interval", "Result V", "Result X", "Width", "Error Est."};
+		binary.reset(new TrajectoryWriter(filename, "oscillator", method, parameter, std::vector<std::string>(names, names + 6), format == CompressedOutput));
+		// Rows are dropped by the writer, so the run still finishes.
+		if (!binary->IsOpen())
+			printf("Unable to create %s, no rows will be written.\n", filename.c_str());
+		return;
+	}
+
+	file = fopen(filename.c_str(), "w");
+
 	fprintf(file, "%-10s%-20s%-20s%-20s%-20s%-20s\n",
 		"Interval", "Time", "Result V", "Result X", "Width", "Error Est.");
 
+	// Rows are formatted and written on a separate thread.
+	text.reset(new PhaseWriter(file, WritePhaseRow));
+}
+
+void PhaseOutput::Write(const PhaseRow & row)
+{
+	if (binary)
+	{
+		double values[6] = {row.t, (double)row.interval, row.v, row.x, row.width, row.error};
+		binary->Write(values);
+	}
+	else if (pixels > 0)
+	{
+		if (!density)
+		{
+			// Energy is conserved, so every state lies on the circle through
+			// the first.
+			double radius = 1.25 * std::sqrt(row.v * row.v + row.x * row.x);
+			if (!(radius > 0))
+				radius = 1;
+			density.reset(new PhaseHistogram(pixels, pixels, -radius, radius, -radius, radius));
+			last = row.t - row.width;
+		}
+
+		// Weighted by the time since the last row, so the image shows the time
+		// spent at each state whether rows are steps or output times.
+		density->Add(row.v, row.x, std::abs(row.t - last));
+		last = row.t;
+	}
+	else
+	{
+		text->Write(row);
+	}
+}
+
+void PhaseOutput::Close()
+{
+	if (binary)
+	{
+		// A file that was never created has already been reported.
+		bool opened = binary->IsOpen();
+		if (!binary->Close() && opened)
+			printf("Unable to write the trajectory file, it is incomplete.\n");
+	}
+	else if (pixels > 0)
+	{
+		if (!density)
+			density.reset(new PhaseHistogram(pixels, pixels, -1, 1, -1, 1));
+		if (!density->WritePGM(filename))
+			printf("Unable to write the density image.\n");
+	}
+	else if (file)
+	{
+		text->Close();
+		fclose(file);
+		file = 0;
+
+		// The buffer filled, so the solver was held up by formatting.
+		if (text->stalls > 0)
+			printf("Output buffer was full %lli times.\n", text->stalls);
+	}
+}
+
+double ErrorEstimate(const Vector & yInitial, const Vector & y)
+{
+	double eInitial = yInitial[0] * yInitial[0] + yInitial[1] * yInitial[1];
+	double e = y[0] * y[0] + y[1] * y[1];
+	return std::abs((eInitial - e)/eInitial);
+}
+
+void AdaptiveDormandPrincePhase(std::string filename, Vector startY, double startT, double finalT, long long points, OutputFormat format)
+{
+	double absError, relError;
+
+	printf("Please enter desired absolute error boundary: ");
+	std::cin >> absError;
+	printf("Please enter desired relative error boundary: ");
+	std::cin >> relError;
+
+	DormandPrince<2, double, DerivativeFunction> solver(DerivativeFunction(), absError, relError);
+
+	double t = startT;
+	Vector y = startY;
+
+	int count = 1;
+	// Initial width of 1, will be changed by the controller immediately.
+	double h = 1;
+
+	int s;
+
+	printf("Writing output to file %s...\n", filename.c_str());
+
+	PhaseOutput output(filename, format, "dopri5", absError);
+
+	if (points > 0)
+	{
+		// Sample within each step using dense output.
+		OutputGrid grid(startT, finalT, points);
+		s = IntegrateOutput(solver, t, finalT, h, y, grid,
+			[&](double t1, const Vector & sample, double width)
+			{
+				output.Write(PhaseRow{grid.Index(), t1, sample[0], sample[1], width, ErrorEstimate(startY, sample)});
+				return true;
+			});
+	}
+	else
+	{
+		s = Integrate(solver, t, finalT, h, y,
+			[&](double t1, const Vector & y1, double width)
+			{
+				output.Write(PhaseRow{count, t1, y1[0], y1[1], width, ErrorEstimate(startY, y1)});
+				count++;
+				return true;
+			});
+	}
+
+	if (s != 0)
+	{
+		printf("Critical failure.\n");
+	}
+
+	output.Close();
+
+	printf("Accepted steps: %lli, rejected steps: %lli, derivative evaluations: %lli\n",
+		solver.accepted, solver.rejected, solver.evaluations);
+
+	return;
+}
+
+void SymplecticPhase(std::string filename, Vector startY, double startT, int intervals, double finalT, OutputFormat format)
+{
+	int order;
+	printf("Please enter order of method (2 Verlet, 4 Forest-Ruth, 6 Yoshida): ");
+
+	while (!(std::cin >> order) || (order != 2 && order != 4 && order != 6))
+	{
+		printf("Enter valid order: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	const double * weights = VerletWeights;
+	int stages = 1;
+	std::string method = "verlet";
+	if (order == 4)
+	{
+		weights = ForestRuthWeights;
+		stages = 3;
+		method = "forest-ruth";
+	}
+	else if (order == 6)
+	{
+		weights = YoshidaSixthWeights;
+		stages = 7;
+		method = "yoshida6";
+	}
+
 	// Initial conditions.
 	double t = startT;
 	double h = (finalT - startT)/intervals;
-	Vector y = startY;
+
+	printf("Writing to file %s...\n", filename.c_str());
+
+	PhaseOutput output(filename, format, method, h);
+
+	// State split into position and velocity.
+	StateVector<1> q, p, a;
+	q[0] = startY[1];
+	p[0] = startY[0];
+	a = Acceleration(t, q);
 
 	for (int i = 0; i != intervals; i++)
 	{
-		// Apply rk 1 time.
-		fprintf(file, "%-10i%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", i, t, y.one, y.two, h, ErrorEstimate(startY, y));
-		y = RungeKuttaStep(Derivative, y, t, h);
+		Vector y(p[0], q[0]);
+		output.Write(PhaseRow{i, t, y[0], y[1], h, ErrorEstimate(startY, y)});
+		// Apply one step of the composition method.
+		CompositionStep(Acceleration, q, p, a, t, h, weights, stages);
 		// Increment t.
 		t += h;
 	}
 
+	output.Close();
+
+	return;
+}
+
+void CachedQuery(TrajectoryCache<2> & cache, Vector startY, double startT, double finalT)
+{
+	int method;
+	printf("Please enter method (1 Runge-Kutta, 2 Dormand-Prince): ");
+
+	while (!(std::cin >> method) || (method != 1 && method != 2))
+	{
+		printf("Enter valid method: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+
+	double parameter;
+	printf(method == 1 ? "Please enter step width: " : "Please enter error boundary: ");
+	std::cin >> parameter;
+
+	// Steps between checkpoints.
+	const long long spacing = method == 1 ? 1000 : 100;
+
+	std::string key = CheckpointKey("oscillator", method == 1 ? "rk2" : "dopri5", parameter, startT, startY);
+
+	// Start from the latest checkpoint before finalT, if there is one.
+	Checkpoint<2> current;
+	const Checkpoint<2> * found;
+	if (cache.Nearest(key, finalT, found))
+	{
+		current = *found;
+		printf("Resuming from checkpoint at t = %.15f after %lli steps.\n", current.t, current.steps);
+	}
+	else
+	{
+		current.t = startT;
+		current.y = startY;
+		current.h = method == 1 ? parameter : 1;
+		current.steps = 0;
+	}
+
+	long long resumed = current.steps;
+	Vector result;
+
+	if (method == 1)
+	{
+		double h = parameter;
+
+		// Whole steps that fit before finalT. Times are found from the step
+		// count so that they don't depend on where the run was resumed.
+		long long whole = (long long)std::floor((finalT - startT)/h + 1e-9);
+
+		while (current.steps < whole)
+		{
+			current.y = RungeKuttaStep(DerivativeFunction(), current.y, current.t, h);
+			current.steps++;
+			current.t = startT + current.steps * h;
+
+			if (current.steps % spacing == 0 || current.steps == whole)
+				cache.Add(key, current);
+		}
+
+		// A final partial step to land on finalT, which isn't cached.
+		result = current.y;
+		if (std::abs(finalT - current.t) > 1e-9 * std::abs(h))
+			result = RungeKuttaStep(DerivativeFunction(), current.y, current.t, finalT - current.t);
+	}
+	else
+	{
+		DormandPrince<2, double, DerivativeFunction> solver(DerivativeFunction(), parameter, parameter);
+
+		// Steps run past finalT rather than being shortened to end on it, so
+		// that every step end is a valid checkpoint. The answer comes from
+		// the dense output of the last step. (The controller history is not
+		// cached, so a resumed run may choose slightly different steps.)
+		double endless = std::numeric_limits<double>::infinity();
+
+		result = current.y;
+		while (current.t < finalT)
+		{
+			if (solver.Apply(current.t, endless, current.h, current.y) != 0)
+			{
+				printf("Critical failure.\n");
+				break;
+			}
+			current.steps++;
+
+			if (current.t >= finalT)
+			{
+				result = solver.Interpolate(finalT);
+				cache.Add(key, current);
+			}
+			else if (current.steps % spacing == 0)
+			{
+				cache.Add(key, current);
+			}
+		}
+	}
+
+	Vector actual = Analytic(finalT);
+
+	printf("New steps taken: %lli (of %lli in total), checkpoints held: %lu\n", current.steps - resumed, current.steps, (unsigned long)cache.Count(key));
+	printf("Result at t = %.15f: v = %.15f, x = %.15f\n", finalT, result[0], result[1]);
+	printf("Analytic error: v %.3e, x %.3e\n", std::abs(result[0] - actual[0]), std::abs(result[1] - actual[1]));
+}
+
+void ExportPhase(std::string filename, double t0, double t1)
+{
+	TrajectoryReader reader(filename);
+
+	if (!reader.IsOpen() || reader.Columns() != 6)
+	{
+		printf("%s is not a binary phase plot file.\n", filename.c_str());
+		return;
+	}
+
+	printf("System: %s, method: %s, step width or tolerance: %g, rows: %lu%s\n",
+		reader.System().c_str(), reader.Method().c_str(), reader.Parameter(), (unsigned long)reader.Rows(),
+		reader.Compressed() ? " (compressed)" : "");
+
+	std::string textname = filename;
+	std::string extension = ".traj";
+	if (textname.size() > extension.size() && textname.compare(textname.size() - extension.size(), extension.size(), extension) == 0)
+		textname.erase(textname.size() - extension.size());
+	else
+		textname += ".txt";
+
+	FILE * file = fopen(textname.c_str(), "w");
+
+	printf("Writing to file %s...\n", textname.c_str());
+
+	fprintf(file, "%-10s%-20s%-20s%-20s%-20s%-20s\n",
+		"Interval", "Time", "Result V", "Result X", "Width", "Error Est.");
+
+	std::size_t rows = reader.Range(t0, t1,
+		[&](const double row[])
+		{
+			PhaseRow phase = {(long long)row[1], row[0], row[2], row[3], row[4], row[5]};
+			WritePhaseRow(file, phase);
+		});
+
 	fclose(file);
 
+	printf("Exported %lu rows.\n", (unsigned long)rows);
+	if (reader.Corrupt())
+		printf("The file is corrupt, values which couldn't be decoded are NaN.\n");
+
 	return;
 }
 
-double ErrorEstimate(const Vector & yInitial, const Vector & y)
+void PararealPhase(std::string filename, Vector startY, double startT, double finalT)
 {
-	double eInitial = yInitial.one * yInitial.one + yInitial.two * yInitial.two;
-	double e = y.one * y.one + y.two * y.two;
-	return std::abs((eInitial - e)/eInitial);
+	long long slices, coarseSteps, fineSteps;
+	double tolerance;
+
+	printf("Please input no. of time slices (%u threads): ", WorkerCount());
+	std::cin >> slices;
+	printf("Please input no. of coarse steps per slice: ");
+	std::cin >> coarseSteps;
+	printf("Please input no. of fine steps per slice: ");
+	std::cin >> fineSteps;
+	printf("Please input convergence tolerance: ");
+	std::cin >> tolerance;
+
+	auto coarse = [&](double t0, double t1, const Vector & y)
+	{
+		return RungeKuttaSecond(DerivativeFunction(), y, t0, coarseSteps, t1);
+	};
+
+	// Each call has its own stepper, as calls run on several threads.
+	auto fine = [&](double t0, double t1, const Vector & y)
+	{
+		gsl_odeiv2_system sys = {Function, Jacobian, 2, parameters};
+		gsl_odeiv2_step * step = gsl_odeiv2_step_alloc(gsl_odeiv2_step_rk4, 2);
+
+		double t = t0;
+		double y1[2];
+		y.ArrayConvert(y1);
+		GSLIntegrateFixed(step, &sys, t, y1, (t1 - t0)/fineSteps, fineSteps,
+			[](double, const double *, const double *, double) { return true; });
+
+		gsl_odeiv2_step_free(step);
+		return Vector(y1);
+	};
+
+	// Serial fine integration, slice by slice, for comparison.
+	auto start = std::chrono::steady_clock::now();
+	Vector serial = startY;
+	for (long long n = 0; n != slices; n++)
+	{
+		double t0 = startT + (finalT - startT)*n/slices;
+		double t1 = (n + 1 == slices) ? finalT : startT + (finalT - startT)*(n + 1)/slices;
+		serial = fine(t0, t1, serial);
+	}
+	double serialTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	std::vector<Vector> states;
+	std::vector<PararealIteration> history = Parareal(coarse, fine, startT, finalT, startY, slices, tolerance, (int)slices, states);
+	double pararealTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Vector result = states.back();
+	double difference = std::max(std::abs(result[0] - serial[0]), std::abs(result[1] - serial[1]));
+	double speedup = serialTime/pararealTime;
+
+	FILE * file = fopen(filename.c_str(), "w");
+
+	printf("Writing to file %s...\n", filename.c_str());
+
+	fprintf(file, "%-10s%-20s%-20s\n", "Iteration", "Defect", "Fine Solves");
+	for (std::size_t k = 0; k != history.size(); k++)
+	{
+		fprintf(file, "%-10lu%-20.12e%-20lu\n", (unsigned long)(k + 1), history[k].defect, (unsigned long)history[k].fineSolves);
+	}
+
+	fprintf(file, "\n%-10s%-20s%-20s%-20s%-20s%-20s\n", "Slices", "Iterations", "Serial Time", "Parareal Time", "Speedup", "Difference");
+	fprintf(file, "%-10lli%-20lu%-20.6f%-20.6f%-20.6f%-20.12e\n", slices, (unsigned long)history.size(), serialTime, pararealTime, speedup, difference);
+
+	fclose(file);
+
+	printf("Result at t = %.15f: v = %.15f, x = %.15f\n", finalT, result[0], result[1]);
+	printf("Iterations: %lu of %lli, difference from serial fine result: %.3e\n", (unsigned long)history.size(), slices, difference);
+	printf("Serial time: %.3f s, Parareal time: %.3f s, speedup: %.2f\n", serialTime, pararealTime, speedup);
+
+	return;
+}
+
+void SensitivityPhase(std::string filename, Vector startY, double startT, double finalT)
+{
+	double p[parameterCount];
+	double absError, relError;
+
+	printf("Please input frequency squared and damping: ");
+	std::cin >> p[0] >> p[1];
+	printf("Please enter desired absolute error boundary: ");
+	std::cin >> absError;
+	printf("Please enter desired relative error boundary: ");
+	std::cin >> relError;
+
+	typedef Dual<double, parameterCount> Number;
+	auto rhs = [](double, const Number y[], const Number q[], Number f[]) { Oscillator(y, q, f); };
+
+	ForwardSensitivity<2, parameterCount, decltype(rhs)> sensitivity(rhs, p, absError, relError);
+	typedef decltype(sensitivity)::State State;
+
+	double t = startT;
+	State y = sensitivity.Start(startY);
+	// Initial width of 1, will be changed by the controller immediately.
+	double h = 1;
+
+	// Steps are kept and written afterwards, so only the integration is
+	// timed.
+	std::vector<double> times(1, t);
+	std::vector<State> states(1, y);
+
+	auto start = std::chrono::steady_clock::now();
+	int s = Integrate(sensitivity, t, finalT, h, y,
+		[&](double t1, const State & y1, double width)
+		{
+			times.push_back(t1);
+			states.push_back(y1);
+			return true;
+		});
+	double sensitivityTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (s != 0)
+	{
+		printf("Critical failure.\n");
+	}
+
+	// Central differences, each run a full integration of the problem with
+	// one parameter perturbed.
+	long long differenceEvaluations = 0;
+	auto solve = [&](const double q[])
+	{
+		auto d = [q](double, const Vector & y)
+		{
+			double in[2], out[2];
+			y.ArrayConvert(in);
+			Oscillator(in, q, out);
+			return Vector(out);
+		};
+		DormandPrince<2, double, decltype(d)> solver(d, absError, relError);
+
+		double t = startT;
+		double h = 1;
+		Vector y = startY;
+		Integrate(solver, t, finalT, h, y, [](double, const Vector &, double) { return true; });
+
+		differenceEvaluations += solver.evaluations;
+		return y;
+	};
+
+	start = std::chrono::steady_clock::now();
+	Vector differences[parameterCount];
+	for (std::size_t k = 0; k != parameterCount; k++)
+	{
+		double delta = 1e-4 * std::max(std::abs(p[k]), 1.0);
+		double q[parameterCount] = {p[0], p[1]};
+
+		q[k] = p[k] + delta;
+		Vector upper = solve(q);
+		q[k] = p[k] - delta;
+		Vector lower = solve(q);
+
+		differences[k] = (upper - lower) / (2 * delta);
+	}
+	double differenceTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	FILE * file = fopen(filename.c_str(), "w");
+
+	printf("Writing to file %s...\n", filename.c_str());
+
+	fprintf(file, "%-20s%-20s%-20s%-20s%-20s%-20s%-20s\n", "Time", "Result V", "Result X", "dV/d(w^2)", "dX/d(w^2)", "dV/dc", "dX/dc");
+	for (std::size_t i = 0; i != states.size(); i++)
+	{
+		const State & y1 = states[i];
+		fprintf(file, "%-20.12f%-20.12e%-20.12e%-20.12e%-20.12e%-20.12e%-20.12e\n", times[i], y1[0], y1[1],
+			sensitivity.Sensitivity(y1, 0, 0), sensitivity.Sensitivity(y1, 1, 0),
+			sensitivity.Sensitivity(y1, 0, 1), sensitivity.Sensitivity(y1, 1, 1));
+	}
+
+	const char * names[parameterCount] = {"w^2", "c"};
+	fprintf(file, "\n%-10s%-20s%-20s%-20s%-20s\n", "Parameter", "Sensitivity V", "Sensitivity X", "Finite Diff. V", "Finite Diff. X");
+	for (std::size_t k = 0; k != parameterCount; k++)
+	{
+		fprintf(file, "%-10s%-20.12e%-20.12e%-20.12e%-20.12e\n", names[k],
+			sensitivity.Sensitivity(y, 0, k), sensitivity.Sensitivity(y, 1, k), differences[k][0], differences[k][1]);
+	}
+
+	fprintf(file, "\n%-20s%-20s%-20s%-20s\n", "Method", "Integrations", "Evaluations", "Time");
+	fprintf(file, "%-20s%-20i%-20lli%-20.6f\n", "Forward", 1, sensitivity.Solver().evaluations, sensitivityTime);
+	fprintf(file, "%-20s%-20i%-20lli%-20.6f\n", "Finite Diff.", (int)(2 * parameterCount), differenceEvaluations, differenceTime);
+
+	fclose(file);
+
+	printf("Accepted steps: %lli, rejected steps: %lli, derivative evaluations: %lli (on dual numbers)\n",
+		sensitivity.Solver().accepted, sensitivity.Solver().rejected, sensitivity.Solver().evaluations);
+	printf("Finite differences: %i integrations, %lli derivative evaluations\n", (int)(2 * parameterCount), differenceEvaluations);
+	printf("Forward time: %.6f s, finite difference time: %.6f s\n", sensitivityTime, differenceTime);
+
+	return;
+}
+
+double CrossingEvent(double t, const Vector & y)
+{
+	return y[1];
+}
+
+double TurningEvent(double t, const Vector & y)
+{
+	return y[0];
+}
+
+void EventPhase(std::string filename, Vector startY, double startT, double finalT)
+{
+	double absError, relError;
+
+	printf("Please enter desired absolute error boundary: ");
+	std::cin >> absError;
+	printf("Please enter desired relative error boundary: ");
+	std::cin >> relError;
+
+	int stop;
+	printf("Stop at first turning point? (1 yes, 0 no): ");
+	std::cin >> stop;
+
+	// Crossings in either direction, and turning points.
+	std::vector<Event<2> > events(2);
+	events[0].g = CrossingEvent;
+	events[0].direction = 0;
+	events[0].terminal = false;
+	events[1].g = TurningEvent;
+	events[1].direction = 0;
+	events[1].terminal = (stop == 1);
+
+	const char * names[2] = {"Crossing", "Turning"};
+
+	DormandPrince<2, double, DerivativeFunction> solver(DerivativeFunction(), absError, relError);
+
+	double t = startT;
+	Vector y = startY;
+	double h = 1;
+
+	std::vector<double> g(events.size());
+	for (std::size_t i = 0; i != events.size(); i++)
+		g[i] = events[i].g(t, y);
+
+	std::vector<EventRecord<2> > records;
+
+	while (t < finalT)
+	{
+		double t0 = t;
+		if (solver.Apply(t, finalT, h, y) != 0)
+		{
+			printf("Critical failure.\n");
+			break;
+		}
+
+		long long terminal = LocateEvents(events, g, solver, t0, t, y, 1e-12, records);
+		if (terminal >= 0)
+		{
+			// Stop at the terminal event.
+			t = records[terminal].t;
+			y = records[terminal].y;
+			break;
+		}
+	}
+
+	FILE * file = fopen(filename.c_str(), "w");
+
+	printf("Writing to file %s...\n", filename.c_str());
+
+	fprintf(file, "%-10s%-20s%-20s%-20s%-20s\n", "Event", "Type", "Time", "Result V", "Result X");
+
+	// Period from successive upward crossings of x.
+	double lastUp = 0;
+	int ups = 0;
+	RunningStatistics period;
+
+	for (std::size_t i = 0; i != records.size(); i++)
+	{
+		EventRecord<2> & r = records[i];
+		fprintf(file, "%-10zu%-20s%-20.15f%-20.15f%-20.15f\n", i, names[r.event], r.t, r.y[0], r.y[1]);
+
+		if (r.event == 0 && r.y[0] > 0)
+		{
+			if (ups > 0)
+				period.Add(r.t - lastUp);
+			lastUp = r.t;
+			ups++;
+		}
+	}
+
+	fclose(file);
+
+	if (period.count > 0)
+		printf("Period: %.15f (analytic %.15f) from %lli cycles\n", period.mean, 2 * M_PI, period.count);
+
+	printf("Stopped at time %.15f, accepted steps: %lli, derivative evaluations: %lli\n", t, solver.accepted, solver.evaluations);
+
+	return;
 }
 
 double  AnalyticV(double t)
@@ -473,25 +1418,35 @@ double AnalyticX(double t)
 int Function(double t, const double y[], double f[], void * params)
 {
 	// See report for details of this equation.
-	f[0] = -y[1];
-	f[1] = y[0];
+	Oscillator(y, (const double *)params, f);
 	return GSL_SUCCESS;
 }
 
 int Jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params)
 {
+	const double * p = (const double *)params;
+	double f[2];
+	// Parameters enter as constants, with zero derivatives.
+	DualJacobian<2, 2>([p](const Dual<double, 2> in[], Dual<double, 2> out[])
+		{
+			Dual<double, 2> q[parameterCount] = {p[0], p[1]};
+			Oscillator(in, q, out);
+		}, y, f, dfdy);
+	// The system doesn't depend on time explicitly.
+	dfdt[0] = 0;
+	dfdt[1] = 0;
 	return GSL_SUCCESS;
 }
 
 void GSLError(std::string filename, Vector startY, double startT, int maxIntervals, double finalT)
 {
-	int * params = 0;
+	double * params = parameters;
 	// Define system for the ODE, with Function, Jacobian and params.
 	// Third argument '2' corresponds to the dimensions of the system
 	// which in this case is 2 (v & x).
 	gsl_odeiv2_system sys = {Function, Jacobian, 2, params};
 
-	// Create driver object for the system. Driver object is a higher level
+	// Create driver objects for the system. Driver object is a higher level
 	// wrapper for all the various GSL functions related to ODE solving.
 	// This wrapper drastically reduces code complexity for our program.
 	//
@@ -502,9 +1457,12 @@ void GSLError(std::string filename, Vector startY, double startT, int maxInterva
 	// two parameters will not be required by the routine, and should be
 	// set to one to prevent failures if the error is not within the
 	// boundary.
-	gsl_odeiv2_driver * driver = gsl_odeiv2_driver_alloc_y_new(&sys, gsl_odeiv2_step_rk4, 1e-3, 1, 1);
-
-	int s;
+	//
+	// A driver holds working memory for the integration, so each worker
+	// thread of the sweep gets its own.
+	std::vector<gsl_odeiv2_driver *> drivers(WorkerCount());
+	for (std::size_t i = 0; i != drivers.size(); i++)
+		drivers[i] = gsl_odeiv2_driver_alloc_y_new(&sys, gsl_odeiv2_step_rk4, 1e-3, 1, 1);
 
 	// Initial conditions from startY
 	double yInitial[2] = {0,0};
@@ -512,9 +1470,27 @@ void GSLError(std::string filename, Vector startY, double startT, int maxInterva
 
 	double yActual[2] = {AnalyticV(finalT), AnalyticX(finalT)};
 
-	double t = startT;
+	// Status and result of one level of the sweep.
+	struct LevelResult
+	{
+		int s;
+		double y[2];
+	};
 
-	double y[2] = {yInitial[0], yInitial[1]};
+	std::vector<long long> steps = SweepSteps(maxIntervals);
+	std::vector<LevelResult> results = ParallelSweep<LevelResult>(steps,
+		[&](unsigned worker, std::size_t level, long long n)
+		{
+			LevelResult result;
+			double t = startT;
+			result.y[0] = yInitial[0];
+			result.y[1] = yInitial[1];
+			// Apply steps of size (goal/n) n times, store result in y.
+			// This means we will always get to the goal in n steps.
+			result.s = gsl_odeiv2_driver_apply_fixed_step(drivers[worker], &t, (finalT-startT)/n, n, result.y);
+			gsl_odeiv2_driver_reset(drivers[worker]);
+			return result;
+		});
 
 	FILE * file = fopen(filename.c_str(), "w");
 			
@@ -522,46 +1498,39 @@ void GSLError(std::string filename, Vector startY, double startT, int maxInterva
 
 	fprintf(file, "%-20s%-20s%-20s%-20s%-20s%-20s\n", "Interval", "Result V", "Result X", "Error V", "Error X", "Width");
 
-	int n;
-	
-	// Loop starts at 50, as the GSL routine fails at very large interval sizes.
-	// Starting from 50 still gives useful results, but prevents failures.
-	for (int i = 0; i <= maxIntervals*2; i++)
-	{
-		n = (int)std::pow(10, i*0.5);
-		// Apply steps of size (goal/i) i times, store result in y.
-		// This means we will always get to the goal in i steps, as our
-		// initial condition for t is t=0.
-		s = gsl_odeiv2_driver_apply_fixed_step(driver, &t, (finalT-startT)/n, n, y);
+	for (std::size_t i = 0; i != steps.size(); i++)
+	{
+		long long n = steps[i];
+		double * y = results[i].y;
 		// Print output if success, but continue on failure, because
 		// higher intervals may solve the problem and give useful
 		// results. 
-		if (s == GSL_SUCCESS)
+		if (results[i].s == GSL_SUCCESS)
 		{
-			fprintf(file, "%-20i%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", n, y[0], y[1], std::abs((y[0] - yActual[0])/yActual[0]), std::abs((y[1] - yActual[1])/yActual[1]), (finalT-startT)/n);
+			fprintf(file, "%-20lli%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", n, y[0], y[1], std::abs((y[0] - yActual[0])/yActual[0]), std::abs((y[1] - yActual[1])/yActual[1]), (finalT-startT)/n);
 		}
-		gsl_odeiv2_driver_reset(driver);
-		y[0] = yInitial[0];
-		y[1] = yInitial[1];
 	}
 
 	fclose(file);
 
-	gsl_odeiv2_driver_free(driver);
+	for (std::size_t i = 0; i != drivers.size(); i++)
+		gsl_odeiv2_driver_free(drivers[i]);
 
 	return;
 }
 
-void GSLPhase(std::string filename, Vector startY, double startT, int intervals, double finalT)
+void GSLPhase(std::string filename, Vector startY, double startT, int intervals, double finalT, long long points, OutputFormat format)
 {
-	int * params = 0;
+	double * params = parameters;
 	// Define system for the ODE, with Function, Jacobian and params.
 	// Third argument '2' corresponds to the dimensions of the system
 	// which in this case is 2 (v & x).
 	gsl_odeiv2_system sys = {Function, Jacobian, 2, params};
 
-	// Driver is the same as previously.
-	gsl_odeiv2_driver * driver = gsl_odeiv2_driver_alloc_y_new(&sys, gsl_odeiv2_step_rk4, 1e-3, 1, 1);
+	// The stepper is used directly rather than through a driver, and the
+	// whole span is integrated in one call with an observer receiving each
+	// step (see integrate.h).
+	gsl_odeiv2_step * step = gsl_odeiv2_step_alloc(gsl_odeiv2_step_rk4, 2);
 
 	// Initial conditions from startY.
 	double yInitial[2] = {0,0};
@@ -569,44 +1538,66 @@ void GSLPhase(std::string filename, Vector startY, double startT, int intervals,
 
 	double y[2] = {yInitial[0], yInitial[1]};
 	double t = startT;
-
-	// Integer for storing output.
-	int s;
-
-	FILE * file = fopen(filename.c_str(), "w");
+	double h = (finalT-startT)/intervals;
 
 	printf("Writing to file %s...\n", filename.c_str());
 
-	fprintf(file, "%-10s%-20s%-20s%-20s%-20s%-20s\n", "Interval", "Time", "Result V", "Result X", "Width", "Error Est.");
+	PhaseOutput output(filename, format, "gsl-rk4", h);
 
-	for (int i = 0; i != intervals; i++)
-	{
-		// Apply one step of size goal/interval.
-		s = gsl_odeiv2_driver_apply_fixed_step(driver, &t, (finalT-startT)/intervals, 1, y);
+	// Start of each step and derivative there, for interpolation. The
+	// derivative at the end comes from the stepper.
+	OutputGrid grid(startT, finalT, points);
+	double t0 = t;
+	Vector y0 = startY;
+	double f[2];
+	Function(t, y, f, params);
+	Vector f0(f);
 
-		// Output.
-		fprintf(file, "%-10i%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", i, t, y[0], y[1], (finalT-startT)/intervals, ErrorEstimate(yInitial, y));
+	int i = 0;
 
-		if (s != GSL_SUCCESS)
+	int s = GSLIntegrateFixed(step, &sys, t, y, h, intervals,
+		[&](double t1, const double y1[], const double f1[], double width)
 		{
-			printf("Critical failure.\nUsually caused by width size being too low, try using larger intervals or a smaller goal time.\n");
-			break;
-		}
+			if (points > 0)
+			{
+				if (i + 1 == intervals)
+					t1 = finalT;
+				while (grid.Pending(t1))
+				{
+					Vector sample = HermiteInterpolate(t0, y0, f0, t1, Vector(y1), Vector(f1), grid.Time());
+					output.Write(PhaseRow{grid.Index(), grid.Time(), sample[0], sample[1], width, ErrorEstimate(startY, sample)});
+					grid.Advance();
+				}
+				t0 = t1;
+				y0 = Vector(y1);
+				f0 = Vector(f1);
+			}
+			else
+			{
+				output.Write(PhaseRow{i, t1, y1[0], y1[1], width, ErrorEstimate(yInitial, y1)});
+			}
+			i++;
+			return true;
+		});
+
+	if (s != GSL_SUCCESS)
+	{
+		printf("Critical failure.\nUsually caused by width size being too low, try using larger intervals or a smaller goal time.\n");
 	}
 
-	fclose(file);
+	output.Close();
 
-	gsl_odeiv2_driver_free(driver);
+	gsl_odeiv2_step_free(step);
 
 	return;
 }
 
-void AdaptiveGSLPhase(std::string filename, Vector startY, double startT, double finalT)
+void AdaptiveGSLPhase(std::string filename, Vector startY, double startT, double finalT, long long points, OutputFormat format)
 {
-	int * params = 0;
+	double * params = parameters;
 	// Define system as before (see question5-2.cpp).
 	gsl_odeiv2_system sys = {Function, Jacobian, 2, params};
-	
+
 	double t = startT;
 	double yInitial[2] = {0,0};
 	startY.ArrayConvert(yInitial);
@@ -614,8 +1605,6 @@ void AdaptiveGSLPhase(std::string filename, Vector startY, double startT, double
 
 	double absError, anaError;
 
-	int s;
-
 	printf("Please enter desired absolute error boundary: ");
 	std::cin >> absError;
 	printf("Please enter desired analytic error boundary: ");
@@ -624,40 +1613,60 @@ void AdaptiveGSLPhase(std::string filename, Vector startY, double startT, double
 	// Create lower level odeiv2 objects, outside of a driver wrapper.
 	// Using fourth order rk, 2 dimensions.
 	gsl_odeiv2_step * step = gsl_odeiv2_step_alloc(gsl_odeiv2_step_rk4, 2);
-	// Use input error amounts. 
+	// Use input error amounts.
 	gsl_odeiv2_control * control = gsl_odeiv2_control_y_new(absError, anaError);
-	// 2 dimensions.
-	gsl_odeiv2_evolve * evolve = gsl_odeiv2_evolve_alloc(2);
 
 	int count = 1;
-	// Initial width of 1, will be changed by the function immediately.
+	// Initial width of 1, will be changed by the controller immediately.
 	double h = 1;
 
-	FILE * file;
-	file = fopen(filename.c_str(), "w");
-
-	fprintf(file, "%-10s%-20s%-20s%-20s%-20s%-20s\n", "Interval", "Time", "Result V", "Result X", "Width", "Error Est.");
 	printf("Writing output to file %s...\n", filename.c_str());
 
-	while (t < finalT)
-	{
-		// Define our starting width as 1, which is expected to change in the first
-		// iteration.
-		s = gsl_odeiv2_evolve_apply(evolve, control, step, &sys, &t, finalT, &h, y);
-		fprintf(file, "%-10i%-20.15f%-20.15f%-20.15f%-20.15f%-20.15f\n", count, t, y[0], y[1], h, ErrorEstimate(yInitial, y));
-		count++;
-		if (s != GSL_SUCCESS)
+	PhaseOutput output(filename, format, "gsl-rk4-adaptive", absError);
+
+	// Start of each step and derivative there, for interpolation. The
+	// derivative at the end comes from the stepper.
+	OutputGrid grid(startT, finalT, points);
+	double t0 = t;
+	Vector y0 = startY;
+	double f[2];
+	Function(t, y, f, params);
+	Vector f0(f);
+
+	// Whole span in one call, with an observer receiving each accepted step
+	// (see integrate.h).
+	int s = GSLIntegrateAdaptive(step, control, &sys, t, finalT, h, y,
+		[&](double t1, const double y1[], const double f1[], double width)
 		{
-			printf("Critical failure.\n");
-			break;
-		}
+			if (points > 0)
+			{
+				while (grid.Pending(t1))
+				{
+					Vector sample = HermiteInterpolate(t0, y0, f0, t1, Vector(y1), Vector(f1), grid.Time());
+					output.Write(PhaseRow{grid.Index(), grid.Time(), sample[0], sample[1], width, ErrorEstimate(startY, sample)});
+					grid.Advance();
+				}
+				t0 = t1;
+				y0 = Vector(y1);
+				f0 = Vector(f1);
+			}
+			else
+			{
+				output.Write(PhaseRow{count, t1, y1[0], y1[1], width, ErrorEstimate(yInitial, y1)});
+			}
+			count++;
+			return true;
+		});
+
+	if (s != GSL_SUCCESS)
+	{
+		printf("Critical failure.\n");
 	}
 
 	gsl_odeiv2_step_free(step);
 	gsl_odeiv2_control_free(control);
-	gsl_odeiv2_evolve_free(evolve);
 
-	fclose(file);
+	output.Close();
 
 	return;
 }
@@ -0,0 +1,132 @@
+/**
+ * Phase space density images, made as the solver runs.
+ *
+ * Phase plots were made by writing every state as text and plotting it in
+ * MATLAB, which is impractical for ensembles or trajectories of 10^8 steps.
+ * Instead each state is binned into a two dimensional histogram over (X, V)
+ * as it is reached, so memory use depends only on the size of the image.
+ * Each thread fills a histogram of its own, and they are merged at the end.
+ *
+ * The histogram is written as a binary greyscale PGM image, which needs no
+ * library and which most image viewers and converters read. Densities span
+ * many orders of magnitude, so grey levels are logarithmic in the density.
+ */
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Weighted histogram of states over a rectangle of the (X, V) plane, with X
+ * across the image and V up it.
+ */
+struct PhaseHistogram
+{
+	std::size_t width;
+	std::size_t height;
+	double minX;
+	double maxX;
+	double minV;
+	double maxV;
+	// Total weight in each pixel, row major from the top row.
+	std::vector<double> bins;
+	// Total weight of states outside the rectangle.
+	double outside;
+
+	/**
+	 * std::size_t width, height : size of the image in pixels.
+	 * double minX, maxX : range of X across the image.
+	 * double minV, maxV : range of V up the image.
+	 */
+	PhaseHistogram(std::size_t width, std::size_t height, double minX, double maxX, double minV, double maxV) :
+		width(width), height(height), minX(minX), maxX(maxX), minV(minV), maxV(maxV),
+		bins(width * height, 0.0), outside(0)
+	{}
+
+	/**
+	 * Add a state. Adaptive steps should be weighted by their width, so the
+	 * density is that of time spent at each state rather than of steps.
+	 */
+	void Add(double v, double x, double weight = 1)
+	{
+		double column = (x - minX) / (maxX - minX) * width;
+		double row = (maxV - v) / (maxV - minV) * height;
+
+		// Also rejects NaN.
+		if (!(column >= 0 && column < width && row >= 0 && row < height))
+		{
+			outside += weight;
+			return;
+		}
+
+		bins[(std::size_t)row * width + (std::size_t)column] += weight;
+	}
+
+	// Combine with a histogram of the same shape, e.g. from another thread.
+	void Merge(const PhaseHistogram & other)
+	{
+		for (std::size_t i = 0; i != bins.size(); i++)
+			bins[i] += other.bins[i];
+		outside += other.outside;
+	}
+
+	void Clear()
+	{
+		std::fill(bins.begin(), bins.end(), 0.0);
+		outside = 0;
+	}
+
+	// Total weight added, inside the rectangle or not.
+	double Total() const
+	{
+		double total = outside;
+		for (std::size_t i = 0; i != bins.size(); i++)
+			total += bins[i];
+		return total;
+	}
+
+	/**
+	 * Write as a binary (P5) PGM image, empty pixels black and the densest
+	 * white. Grey levels go with log(1 + w / w0), where w0 is the smallest
+	 * non-zero weight, so a single visit is always visible.
+	 *
+	 * std::string filename : output filename.
+	 * return : false if the file could not be written.
+	 */
+	bool WritePGM(std::string filename) const
+	{
+		double largest = 0;
+		double smallest = 0;
+		for (std::size_t i = 0; i != bins.size(); i++)
+		{
+			largest = std::max(largest, bins[i]);
+			if (bins[i] > 0 && (smallest == 0 || bins[i] < smallest))
+				smallest = bins[i];
+		}
+
+		std::vector<unsigned char> pixels(bins.size(), 0);
+		if (largest > 0)
+		{
+			double scale = 255 / std::log1p(largest / smallest);
+			for (std::size_t i = 0; i != bins.size(); i++)
+				pixels[i] = (unsigned char)std::lround(scale * std::log1p(bins[i] / smallest));
+		}
+
+		FILE * file = fopen(filename.c_str(), "wb");
+		if (!file)
+			return false;
+
+		fprintf(file, "P5\n# X from %g to %g, V from %g to %g\n%zu %zu\n255\n", minX, maxX, minV, maxV, width, height);
+		bool written = fwrite(&pixels[0], 1, pixels.size(), file) == pixels.size();
+
+		return fclose(file) == 0 && written;
+	}
+};
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * Explicit Runge-Kutta steppers written on top of StateVector, so the same
+ * code serves any fixed dimension of system.
+ *
+ * The derivative is passed as a template parameter rather than a function
+ * pointer. Anything callable as d(double t, const StateVector<N, T> & y) and
+ * returning a StateVector<N, T> (or an expression of one) can be used, and
+ * the compiler is free to inline it into the stepper.
+ */
+
+#ifndef RUNGEKUTTA_H
+#define RUNGEKUTTA_H
+
+#include <cstddef>
+#include "statevector.h"
+#include "butcher.h"
+
+/**
+ * Function that performs one step of the second order Runge-Kutta method.
+ *
+ * d : derivative function for the problem.
+ * StateVector y0 : value of y at start of step.
+ * double t0 : value of t at start of step.
+ * double h : width of step.
+ * return : estimate value of y at t0 + h.
+ */
+template <typename F, std::size_t N, typename T>
+StateVector<N, T> RungeKuttaStep(F d, const StateVector<N, T> & y0, double t0, double h)
+{
+	// The midpoint tableau (see butcher.h), giving the same results as
+	// writing out k1 = h d(t0, y0), k2 = h d(t0 + h/2, y0 + k1/2).
+	return ButcherStep<Midpoint>(d, y0, t0, h);
+}
+
+/**
+ * Function that applies second order Runge-Kutta using specified derivative
+ * function. Uses intervals number of intervals.
+ *
+ * d : derivative function for the problem.
+ * StateVector startY : initial conditions for the solution.
+ * double startT : start time for initial conditions.
+ * long long intervals : number of intervals to use in rk method.
+ * double finalT : goal time.
+ * return : estimate for y at time finalT
+ */
+template <typename F, std::size_t N, typename T>
+StateVector<N, T> RungeKuttaSecond(F d, const StateVector<N, T> & startY, double startT, long long intervals, double finalT)
+{
+	double h = (finalT - startT)/intervals;
+
+	StateVector<N, T> y = startY;
+	double t = startT;
+
+	// Invariant: we have moved to time t = startT + i*h.
+	for (long long i = 0; i != intervals; i++)
+	{
+		y = RungeKuttaStep(d, y, t, h);
+		t += h;
+	}
+
+	return y;
+}
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * Source code for a program which integrates a large ensemble of paths of a
+ * noisy, damped oscillator,
+ *
+ * 	dv = (-x - c v) dt + s v dW, dx = v dt,
+ *
+ * where the damping fluctuates as white noise of strength s, using the
+ * stochastic integrators in sde.h. Every path starts from v = 1, x = 0.
+ *
+ * The first and second moments of this system obey linear ODEs of their own,
+ * which are integrated accurately for comparison with the ensemble means and
+ * standard deviations at each output time.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "statevector.h"
+#include "rungekutta.h"
+#include "sde.h"
+
+typedef StateVector<2> Vector;
+
+/**
+ * Drift of the system, v' and x' without noise.
+ *
+ * double damping : c.
+ */
+struct Drift
+{
+	double damping;
+
+	Vector operator()(double t, const Vector & y) const
+	{
+		Vector temp;
+		temp[0] = -y[1] - damping * y[0];
+		temp[1] = y[0];
+		return temp;
+	}
+};
+
+/**
+ * Diffusion of the system, multiplying dW. Templated so that Milstein's
+ * method can differentiate it on dual numbers.
+ *
+ * double noise : s.
+ */
+struct Diffusion
+{
+	double noise;
+
+	template <typename T>
+	StateVector<2, T> operator()(double t, const StateVector<2, T> & y) const
+	{
+		StateVector<2, T> temp;
+		temp[0] = noise * y[0];
+		temp[1] = 0;
+		return temp;
+	}
+};
+
+/**
+ * Moments gives the derivative of the first and second moments of the
+ * system, (E[v], E[x], E[v^2], E[vx], E[x^2]), by Ito's formula.
+ *
+ * double damping : c.
+ * double noise : s.
+ */
+struct Moments
+{
+	double damping;
+	double noise;
+
+	StateVector<5> operator()(double t, const StateVector<5> & m) const
+	{
+		StateVector<5> temp;
+		temp[0] = -m[1] - damping * m[0];
+		temp[1] = m[0];
+		temp[2] = -2 * m[3] - 2 * damping * m[2] + noise * noise * m[2];
+		temp[3] = m[2] - m[4] - damping * m[3];
+		temp[4] = 2 * m[3];
+		return temp;
+	}
+};
+
+/**
+ * Main function, asks for the ensemble size and integration parameters, then
+ * integrates the ensemble and writes statistics to file.
+ */
+int main()
+{
+	std::size_t paths;
+	printf("Please input no. of paths: ");
+	std::cin >> paths;
+
+	double startT = 0;
+	double finalT;
+	printf("Please input goal time: ");
+	std::cin >> finalT;
+
+	std::size_t outputs;
+	printf("Please input no. of output times: ");
+	std::cin >> outputs;
+
+	long long intervals;
+	printf("Please input no. of intervals: ");
+	std::cin >> intervals;
+
+	// As SDEEnsemble will, so the steps reported are the steps taken.
+	if (outputs < 1)
+		outputs = 1;
+	intervals = SDEIntervals(intervals, outputs);
+
+	int choice;
+	printf("Please input method (0 Euler-Maruyama, 1 Milstein, 2 stochastic Runge-Kutta): ");
+	while (!(std::cin >> choice) || choice < 0 || choice > 2)
+	{
+		printf("Enter valid method: ");
+		std::cin.clear();
+		std::cin.ignore();
+	}
+	SDEMethod method = (SDEMethod)choice;
+
+	Drift drift;
+	Diffusion diffusion;
+	printf("Please input damping and noise strength: ");
+	std::cin >> drift.damping >> diffusion.noise;
+
+	std::uint64_t seed;
+	printf("Please input random seed: ");
+	std::cin >> seed;
+
+	Vector startY;
+	startY[0] = 1;
+	startY[1] = 0;
+
+	printf("Integrating %zu paths of %lli steps on %u threads...\n", paths, intervals, WorkerCount());
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<RunningStatistics> statistics;
+	switch (method)
+	{
+		case Milstein:
+			statistics = SDEEnsemble<Milstein>(drift, diffusion, startY, startT, intervals, finalT, paths, seed, outputs);
+			break;
+		case StochasticRungeKutta:
+			statistics = SDEEnsemble<StochasticRungeKutta>(drift, diffusion, startY, startT, intervals, finalT, paths, seed, outputs);
+			break;
+		default:
+			statistics = SDEEnsemble<EulerMaruyama>(drift, diffusion, startY, startT, intervals, finalT, paths, seed, outputs);
+			break;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Exact moments, from many small steps of the moment equations.
+	Moments moments = {drift.damping, diffusion.noise};
+	StateVector<5> m;
+	m[0] = startY[0];
+	m[1] = startY[1];
+	m[2] = startY[0] * startY[0];
+	m[3] = startY[0] * startY[1];
+	m[4] = startY[1] * startY[1];
+
+	FILE * file = fopen("sde_out", "w");
+
+	printf("Writing to file 'sde_out'...\n");
+
+	fprintf(file, "%-20s%-20s%-20s%-20s%-20s%-20s%-20s%-20s%-20s\n", "Time", "Mean V", "Exact Mean V", "Std. Dev. V", "Exact Std. Dev. V",
+		"Mean X", "Exact Mean X", "Std. Dev. X", "Exact Std. Dev. X");
+
+	double t = startT;
+	for (std::size_t k = 0; k != outputs; k++)
+	{
+		double t1 = startT + (finalT - startT)*(k + 1)/outputs;
+		m = RungeKuttaSecond(moments, m, t, 10000, t1);
+		t = t1;
+
+		const RunningStatistics & v = statistics[k*2];
+		const RunningStatistics & x = statistics[k*2 + 1];
+		fprintf(file, "%-20.12f%-20.12f%-20.12f%-20.12f%-20.12f%-20.12f%-20.12f%-20.12f%-20.12f\n", t1,
+			v.mean, m[0], v.StandardDeviation(), std::sqrt(std::max(m[2] - m[0]*m[0], 0.0)),
+			x.mean, m[1], x.StandardDeviation(), std::sqrt(std::max(m[4] - m[1]*m[1], 0.0)));
+	}
+
+	fprintf(file, "\n%-20s%-20s%-20s%-20s\n", "Paths", "Steps", "Time", "Path Steps/s");
+	fprintf(file, "%-20zu%-20lli%-20.6f%-20.6e\n", paths, intervals, seconds, paths * (double)intervals / seconds);
+
+	fclose(file);
+
+	printf("%.3f s, %.3e path steps per second.\n", seconds, paths * (double)intervals / seconds);
+	printf("Done!\n");
+
+	return 0;
+}
@@ -0,0 +1,268 @@
+/**
+ * Fixed step integrators for stochastic differential equations with
+ * diagonal noise,
+ *
+ * 	dy_i = a_i(t, y) dt + b_i(t, y) dW_i,
+ *
+ * where the W_i are independent Wiener processes, in the Ito sense.
+ *
+ * Three schemes are given, all taking the Wiener increments dW ~ N(0, h) of
+ * the step as an argument:
+ *
+ * 	Euler-Maruyama, strong order 1/2: y + a h + b dW.
+ * 	Milstein, strong order 1, adding 1/2 b db_i/dy_i (dW^2 - h). The
+ * 	derivative of the diffusion is found exactly on dual numbers, so the
+ * 	diffusion must be templated over its number type.
+ * 	A stochastic Runge-Kutta scheme (Platen's derivative free Milstein),
+ * 	strong order 1, replacing db/dy by a difference of b at a supporting
+ * 	value, so any diffusion function will do.
+ *
+ * The scheme is a template parameter of SDEStep, SDEIntegrate and SDEEnsemble,
+ * so only Milstein's method needs the diffusion on dual numbers.
+ *
+ * Large ensembles of paths are run across threads by SDEEnsemble. Each path
+ * draws its increments from its own counter-based random stream (see
+ * random.h), so a path is the same whichever thread runs it, and only running
+ * statistics of the state at the output times are kept, not the paths.
+ */
+
+#ifndef SDE_H
+#define SDE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include "statevector.h"
+#include "statistics.h"
+#include "parallel.h"
+#include "random.h"
+#include "../../common/dual.h"
+
+enum SDEMethod {EulerMaruyama, Milstein, StochasticRungeKutta};
+
+/**
+ * One step of the Euler-Maruyama method.
+ *
+ * a : drift, called as a(double t, const StateVector<N, T> & y).
+ * b : diffusion, called in the same way, component i multiplying dW_i.
+ * StateVector y0 : value of y at start of step.
+ * double t0 : value of t at start of step.
+ * double h : width of step.
+ * StateVector dW : Wiener increments over the step.
+ * return : value of y at t0 + h.
+ */
+template <typename A, typename B, std::size_t N, typename T>
+StateVector<N, T> EulerMaruyamaStep(A a, B b, const StateVector<N, T> & y0, double t0, double h, const StateVector<N, T> & dW)
+{
+	StateVector<N, T> diffusion = b(t0, y0);
+	StateVector<N, T> y = y0 + h * a(t0, y0);
+	for (std::size_t i = 0; i != N; i++)
+		y[i] += diffusion[i] * dW[i];
+	return y;
+}
+
+/**
+ * One step of the Milstein method, arguments as EulerMaruyamaStep. b must
+ * also accept a StateVector of Dual<T, N>.
+ */
+template <typename A, typename B, std::size_t N, typename T>
+StateVector<N, T> MilsteinStep(A a, B b, const StateVector<N, T> & y0, double t0, double h, const StateVector<N, T> & dW)
+{
+	// Diffusion and its Jacobian in one evaluation, only the diagonal is
+	// needed for diagonal noise.
+	StateVector<N, Dual<T, N> > yDual;
+	for (std::size_t j = 0; j != N; j++)
+		yDual[j] = Dual<T, N>(y0[j], j);
+	StateVector<N, Dual<T, N> > diffusion = b(t0, yDual);
+
+	StateVector<N, T> y = y0 + h * a(t0, y0);
+	for (std::size_t i = 0; i != N; i++)
+	{
+		T bi = diffusion[i].value;
+		y[i] += bi * dW[i] + 0.5 * bi * diffusion[i].d[i] * (dW[i] * dW[i] - h);
+	}
+	return y;
+}
+
+/**
+ * One step of Platen's derivative free stochastic Runge-Kutta scheme,
+ * arguments as EulerMaruyamaStep. The supporting value is
+ * y0 + a h + b sqrt(h).
+ */
+template <typename A, typename B, std::size_t N, typename T>
+StateVector<N, T> StochasticRungeKuttaStep(A a, B b, const StateVector<N, T> & y0, double t0, double h, const StateVector<N, T> & dW)
+{
+	double root = std::sqrt(h);
+
+	StateVector<N, T> drift = a(t0, y0);
+	StateVector<N, T> diffusion = b(t0, y0);
+	StateVector<N, T> support = y0 + h * drift + root * diffusion;
+	StateVector<N, T> supportDiffusion = b(t0, support);
+
+	StateVector<N, T> y = y0 + h * drift;
+	for (std::size_t i = 0; i != N; i++)
+		y[i] += diffusion[i] * dW[i] + (supportDiffusion[i] - diffusion[i]) * (dW[i] * dW[i] - h) / (2 * root);
+	return y;
+}
+
+// Step of each method, chosen at compile time so that only the method used
+// is instantiated.
+template <SDEMethod Method>
+struct SDEScheme;
+
+template <>
+struct SDEScheme<EulerMaruyama>
+{
+	template <typename A, typename B, std::size_t N, typename T>
+	static StateVector<N, T> Step(A a, B b, const StateVector<N, T> & y0, double t0, double h, const StateVector<N, T> & dW)
+	{
+		return EulerMaruyamaStep(a, b, y0, t0, h, dW);
+	}
+};
+
+template <>
+struct SDEScheme<Milstein>
+{
+	template <typename A, typename B, std::size_t N, typename T>
+	static StateVector<N, T> Step(A a, B b, const StateVector<N, T> & y0, double t0, double h, const StateVector<N, T> & dW)
+	{
+		return MilsteinStep(a, b, y0, t0, h, dW);
+	}
+};
+
+template <>
+struct SDEScheme<StochasticRungeKutta>
+{
+	template <typename A, typename B, std::size_t N, typename T>
+	static StateVector<N, T> Step(A a, B b, const StateVector<N, T> & y0, double t0, double h, const StateVector<N, T> & dW)
+	{
+		return StochasticRungeKuttaStep(a, b, y0, t0, h, dW);
+	}
+};
+
+/**
+ * One step of method Method, arguments as EulerMaruyamaStep.
+ */
+template <SDEMethod Method, typename A, typename B, std::size_t N, typename T>
+StateVector<N, T> SDEStep(A a, B b, const StateVector<N, T> & y0, double t0, double h, const StateVector<N, T> & dW)
+{
+	return SDEScheme<Method>::Step(a, b, y0, t0, h, dW);
+}
+
+/**
+ * Function that integrates one path of an SDE with intervals steps of method
+ * Method, in the manner of RungeKuttaSecond.
+ *
+ * a : drift.
+ * b : diffusion.
+ * StateVector startY : initial conditions for the path.
+ * double startT : start time for initial conditions.
+ * long long intervals : number of intervals to use.
+ * double finalT : goal time.
+ * NormalStream & noise : random stream of the path, continued from where
+ * 	it is.
+ * return : value of y at finalT on this path.
+ */
+template <SDEMethod Method, typename A, typename B, std::size_t N, typename T>
+StateVector<N, T> SDEIntegrate(A a, B b, const StateVector<N, T> & startY, double startT, long long intervals, double finalT, NormalStream & noise)
+{
+	double h = (finalT - startT)/intervals;
+	double root = std::sqrt(std::abs(h));
+
+	StateVector<N, T> y = startY;
+	StateVector<N, T> dW;
+	double t = startT;
+
+	// Invariant: we have moved to time t = startT + i*h.
+	for (long long i = 0; i != intervals; i++)
+	{
+		for (std::size_t j = 0; j != N; j++)
+			dW[j] = root * noise.Next();
+		y = SDEStep<Method>(a, b, y, t, h, dW);
+		t = startT + (i + 1)*h;
+	}
+
+	return y;
+}
+
+/**
+ * Number of intervals SDEEnsemble uses: at least one per output, rounded up
+ * to a multiple of outputs so that every output time falls on a step
+ * boundary.
+ *
+ * long long intervals : number of intervals asked for.
+ * std::size_t outputs : number of output times, at least 1.
+ */
+inline long long SDEIntervals(long long intervals, std::size_t outputs)
+{
+	long long n = (long long)outputs;
+	if (intervals < n)
+		intervals = n;
+	return (intervals + n - 1) / n * n;
+}
+
+/**
+ * SDEEnsemble integrates paths paths of method Method from the same initial
+ * conditions, path p drawing from stream p of seed, split across the worker
+ * threads. Each path is integrated by SDEIntegrate between output times. The
+ * statistics of every component are accumulated on the fly at outputs evenly
+ * spaced times, so memory use depends on neither the number of paths nor of
+ * steps.
+ *
+ * a : drift.
+ * b : diffusion.
+ * StateVector startY : initial conditions for every path.
+ * double startT : start time for initial conditions.
+ * long long intervals : number of intervals to use, rounded by SDEIntervals.
+ * double finalT : goal time.
+ * std::size_t paths : number of paths.
+ * std::uint64_t seed : key of the random streams.
+ * std::size_t outputs : number of output times, the last at finalT, at
+ * 	least 1.
+ * return : statistics of component i at output time k + 1 in element
+ * 	k*N + i.
+ */
+template <SDEMethod Method, typename A, typename B, std::size_t N, typename T>
+std::vector<RunningStatistics> SDEEnsemble(A a, B b, const StateVector<N, T> & startY, double startT, long long intervals, double finalT, std::size_t paths, std::uint64_t seed, std::size_t outputs)
+{
+	if (outputs < 1)
+		outputs = 1;
+	intervals = SDEIntervals(intervals, outputs);
+
+	long long stride = intervals / outputs;
+
+	// Statistics of each worker, merged at the end.
+	std::vector<std::vector<RunningStatistics> > partial(WorkerCount(), std::vector<RunningStatistics>(outputs * N));
+
+	ParallelFor(paths, [&](unsigned worker, std::size_t begin, std::size_t end)
+	{
+		std::vector<RunningStatistics> & statistics = partial[worker];
+
+		for (std::size_t p = begin; p != end; p++)
+		{
+			NormalStream noise(seed, p);
+			StateVector<N, T> y = startY;
+			double t = startT;
+
+			for (std::size_t k = 0; k != outputs; k++)
+			{
+				double t1 = startT + (finalT - startT)*(k + 1)/outputs;
+				y = SDEIntegrate<Method>(a, b, y, t, stride, t1, noise);
+				t = t1;
+
+				for (std::size_t j = 0; j != N; j++)
+					statistics[k*N + j].Add(y[j]);
+			}
+		}
+	});
+
+	std::vector<RunningStatistics> statistics(outputs * N);
+	for (std::size_t w = 0; w != partial.size(); w++)
+		for (std::size_t i = 0; i != statistics.size(); i++)
+			statistics[i].Merge(partial[w][i]);
+
+	return statistics;
+}
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * Forward sensitivity analysis: derivatives of the solution with respect to
+ * the parameters of the problem, integrated alongside the solution.
+ *
+ * For y' = f(t, y, p) with P parameters, the sensitivities s_k = dy/dp_k obey
+ *
+ * 	s_k' = J s_k + df/dp_k,
+ *
+ * where J = df/dy. The state and all P sensitivities are stacked into one
+ * augmented state of N (P + 1) components and integrated together, so they
+ * share the stages and step size controller of a single Dormand-Prince run
+ * (see dormandprince.h), and the sensitivities are controlled to the same
+ * tolerance as the state.
+ *
+ * The derivative of the augmented state needs J s_k + df/dp_k for every k.
+ * Rather than forming J, f is evaluated once on dual numbers (see dual.h)
+ * with seed direction k carrying s_k in the state and a unit derivative in
+ * parameter k. The derivative parts of the result are then exactly the P
+ * right hand sides, and the value parts are f itself, all from one pass.
+ *
+ * Compare this with finite differences, which integrate the whole problem
+ * again at p +- delta for every parameter (2 P extra integrations, each
+ * choosing its own steps) and are accurate only to the truncation error of
+ * the difference and the tolerance of the runs.
+ */
+
+#ifndef SENSITIVITY_H
+#define SENSITIVITY_H
+
+#include <cstddef>
+#include "statevector.h"
+#include "dormandprince.h"
+#include "../../common/dual.h"
+
+/**
+ * Derivative of the augmented state for a problem of dimension N with P
+ * parameters. The augmented state holds y in components [0, N) and s_k in
+ * components [N (k + 1), N (k + 2)).
+ *
+ * F is the right hand side, called as f(double t, const T y[], const T p[],
+ * T f[]) with T = Dual<double, P>, for example a templated function.
+ */
+template <std::size_t N, std::size_t P, typename F>
+class SensitivityDerivative
+{
+public:
+	/**
+	 * F f : right hand side of the problem.
+	 * const double p[] : P parameter values to differentiate at.
+	 */
+	SensitivityDerivative(F f, const double p[]) :
+		f(f)
+	{
+		for (std::size_t k = 0; k != P; k++)
+			parameters[k] = p[k];
+	}
+
+	StateVector<N * (P + 1)> operator()(double t, const StateVector<N * (P + 1)> & y) const
+	{
+		Dual<double, P> in[N], q[P], out[N];
+
+		// Seed k carries the direction s_k through the state, and parameter
+		// k itself.
+		for (std::size_t i = 0; i != N; i++)
+		{
+			in[i] = Dual<double, P>(y[i]);
+			for (std::size_t k = 0; k != P; k++)
+				in[i].d[k] = y[N * (k + 1) + i];
+		}
+		for (std::size_t k = 0; k != P; k++)
+			q[k] = Dual<double, P>(parameters[k], k);
+
+		f(t, in, q, out);
+
+		StateVector<N * (P + 1)> result;
+		for (std::size_t i = 0; i != N; i++)
+		{
+			result[i] = out[i].value;
+			for (std::size_t k = 0; k != P; k++)
+				result[N * (k + 1) + i] = out[i].d[k];
+		}
+		return result;
+	}
+
+private:
+	F f;
+	double parameters[P];
+};
+
+/**
+ * Adaptive integrator for the state and its sensitivities together, using
+ * the Dormand-Prince integrator on the augmented state.
+ */
+template <std::size_t N, std::size_t P, typename F>
+class ForwardSensitivity
+{
+public:
+	typedef StateVector<N * (P + 1)> State;
+
+	/**
+	 * F f : right hand side, see SensitivityDerivative.
+	 * const double p[] : P parameter values.
+	 * double absError : absolute error boundary, for state and
+	 * 	sensitivities.
+	 * double relError : relative error boundary.
+	 */
+	ForwardSensitivity(F f, const double p[], double absError, double relError) :
+		solver(SensitivityDerivative<N, P, F>(f, p), absError, relError)
+	{
+	}
+
+	/**
+	 * Augmented state for initial conditions y, with zero sensitivities as
+	 * the initial conditions don't depend on the parameters.
+	 */
+	static State Start(const StateVector<N> & y)
+	{
+		State augmented;
+		for (std::size_t i = 0; i != N * (P + 1); i++)
+			augmented[i] = i < N ? y[i] : 0;
+		return augmented;
+	}
+
+	/**
+	 * Sensitivity dy_i/dp_k held in an augmented state.
+	 */
+	static double Sensitivity(const State & y, std::size_t i, std::size_t k)
+	{
+		return y[N * (k + 1) + i];
+	}
+
+	/**
+	 * Advance by one accepted step, as DormandPrince::Apply.
+	 */
+	int Apply(double & t, double t1, double & h, State & y)
+	{
+		return solver.Apply(t, t1, h, y);
+	}
+
+	/**
+	 * Dense output of state and sensitivities within the last step.
+	 */
+	State Interpolate(double t) const
+	{
+		return solver.Interpolate(t);
+	}
+
+	// Underlying integrator, for its step and evaluation counts. Each
+	// evaluation is one pass of f on dual numbers.
+	const DormandPrince<N * (P + 1), double, SensitivityDerivative<N, P, F> > & Solver() const
+	{
+		return solver;
+	}
+
+private:
+	DormandPrince<N * (P + 1), double, SensitivityDerivative<N, P, F> > solver;
+};
+
+#endif
@@ -0,0 +1,276 @@
+/**
+ * Fixed size state vector for systems of ordinary differential equations.
+ *
+ * StateVector<N, T> replaces the old two member Vector struct. Arithmetic on
+ * state vectors is done with expression templates: an expression such as
+ * y0 + h * k1 / 2.0 builds a small tree of lightweight objects and nothing is
+ * computed until it is assigned to a StateVector. The assignment then runs a
+ * single loop over the N components, so chains of additions and scalings are
+ * fused into one pass with no temporary vectors. As N is known at compile time
+ * that loop is unrolled or vectorised by the compiler.
+ *
+ * Expression objects hold references to StateVector operands, so they should
+ * be assigned within the statement that creates them rather than stored.
+ */
+
+#ifndef STATEVECTOR_H
+#define STATEVECTOR_H
+
+#include <cstddef>
+
+/**
+ * Base of every vector expression. Uses the curiously recurring template
+ * pattern so that operators can accept any expression type while still
+ * knowing the concrete type at compile time.
+ */
+template <typename E>
+struct VectorExpression
+{
+	const E & Self() const
+	{
+		return static_cast<const E &>(*this);
+	}
+};
+
+template <std::size_t N, typename T = double>
+struct StateVector;
+
+/**
+ * How an operand is held inside an expression. State vectors are held by
+ * reference (copying them would defeat the point), whereas intermediate
+ * expression nodes are tiny and are held by value.
+ */
+template <typename E>
+struct ExpressionOperand
+{
+	typedef const E type;
+};
+
+template <std::size_t N, typename T>
+struct ExpressionOperand<StateVector<N, T> >
+{
+	typedef const StateVector<N, T> & type;
+};
+
+// Element-wise sum of two expressions.
+template <typename L, typename R>
+struct VectorSum : VectorExpression<VectorSum<L, R> >
+{
+	typedef typename L::value_type value_type;
+	static const std::size_t size = L::size;
+
+	typename ExpressionOperand<L>::type lhs;
+	typename ExpressionOperand<R>::type rhs;
+
+	VectorSum(const L & l, const R & r) :
+		lhs(l), rhs(r)
+	{
+		static_assert(L::size == R::size, "Vector sizes must match.");
+	}
+
+	value_type operator[](std::size_t i) const
+	{
+		return lhs[i] + rhs[i];
+	}
+};
+
+// Element-wise difference of two expressions.
+template <typename L, typename R>
+struct VectorDifference : VectorExpression<VectorDifference<L, R> >
+{
+	typedef typename L::value_type value_type;
+	static const std::size_t size = L::size;
+
+	typename ExpressionOperand<L>::type lhs;
+	typename ExpressionOperand<R>::type rhs;
+
+	VectorDifference(const L & l, const R & r) :
+		lhs(l), rhs(r)
+	{
+		static_assert(L::size == R::size, "Vector sizes must match.");
+	}
+
+	value_type operator[](std::size_t i) const
+	{
+		return lhs[i] - rhs[i];
+	}
+};
+
+// Expression multiplied by a scalar.
+template <typename E>
+struct VectorScale : VectorExpression<VectorScale<E> >
+{
+	typedef typename E::value_type value_type;
+	static const std::size_t size = E::size;
+
+	typename ExpressionOperand<E>::type expr;
+	value_type scalar;
+
+	VectorScale(const E & e, value_type s) :
+		expr(e), scalar(s)
+	{}
+
+	value_type operator[](std::size_t i) const
+	{
+		return scalar * expr[i];
+	}
+};
+
+// Expression divided by a scalar. Kept separate from VectorScale so that the
+// results are identical to dividing each component.
+template <typename E>
+struct VectorQuotient : VectorExpression<VectorQuotient<E> >
+{
+	typedef typename E::value_type value_type;
+	static const std::size_t size = E::size;
+
+	typename ExpressionOperand<E>::type expr;
+	value_type scalar;
+
+	VectorQuotient(const E & e, value_type s) :
+		expr(e), scalar(s)
+	{}
+
+	value_type operator[](std::size_t i) const
+	{
+		return expr[i] / scalar;
+	}
+};
+
+/**
+ * State vector of N components of type T. For the oscillator in worksheet3
+ * N = 2 and the components are y[0] = v and y[1] = x.
+ */
+template <std::size_t N, typename T>
+struct StateVector : VectorExpression<StateVector<N, T> >
+{
+	typedef T value_type;
+	static const std::size_t size = N;
+
+	T data[N];
+
+	StateVector()
+	{}
+
+	// Convenience constructor for two dimensional systems.
+	StateVector(T first, T second)
+	{
+		static_assert(N == 2, "Two argument constructor requires N = 2.");
+		data[0] = first;
+		data[1] = second;
+	}
+
+	explicit StateVector(const T arr[])
+	{
+		for (std::size_t i = 0; i != N; i++)
+			data[i] = arr[i];
+	}
+
+	// Evaluate an expression, this is where all the work happens.
+	template <typename E>
+	StateVector(const VectorExpression<E> & other)
+	{
+		Assign(other.Self());
+	}
+
+	template <typename E>
+	StateVector & operator=(const VectorExpression<E> & other)
+	{
+		Assign(other.Self());
+		return *this;
+	}
+
+	template <typename E>
+	StateVector & operator+=(const VectorExpression<E> & other)
+	{
+		static_assert(E::size == N, "Vector sizes must match.");
+		const E & e = other.Self();
+		for (std::size_t i = 0; i != N; i++)
+			data[i] += e[i];
+		return *this;
+	}
+
+	template <typename E>
+	StateVector & operator-=(const VectorExpression<E> & other)
+	{
+		static_assert(E::size == N, "Vector sizes must match.");
+		const E & e = other.Self();
+		for (std::size_t i = 0; i != N; i++)
+			data[i] -= e[i];
+		return *this;
+	}
+
+	StateVector & operator*=(T scalar)
+	{
+		for (std::size_t i = 0; i != N; i++)
+			data[i] *= scalar;
+		return *this;
+	}
+
+	T & operator[](std::size_t i)
+	{
+		return data[i];
+	}
+
+	const T & operator[](std::size_t i) const
+	{
+		return data[i];
+	}
+
+	void ArrayConvert(T out[]) const
+	{
+		for (std::size_t i = 0; i != N; i++)
+			out[i] = data[i];
+	}
+
+private:
+	template <typename E>
+	void Assign(const E & e)
+	{
+		static_assert(E::size == N, "Vector sizes must match.");
+		// Every expression is element-wise, so it is safe for e to refer
+		// to this vector (as in y = y + h * k).
+		for (std::size_t i = 0; i != N; i++)
+			data[i] = e[i];
+	}
+};
+
+// Defining the arithmetic operators on expressions.
+template <typename L, typename R>
+VectorSum<L, R> operator+(const VectorExpression<L> & lhs, const VectorExpression<R> & rhs)
+{
+	return VectorSum<L, R>(lhs.Self(), rhs.Self());
+}
+
+template <typename L, typename R>
+VectorDifference<L, R> operator-(const VectorExpression<L> & lhs, const VectorExpression<R> & rhs)
+{
+	return VectorDifference<L, R>(lhs.Self(), rhs.Self());
+}
+
+template <typename E>
+VectorScale<E> operator-(const VectorExpression<E> & rhs)
+{
+	return VectorScale<E>(rhs.Self(), -1);
+}
+
+// Defining scalar multiplication.
+template <typename E>
+VectorScale<E> operator*(const VectorExpression<E> & lhs, typename E::value_type rhs)
+{
+	return VectorScale<E>(lhs.Self(), rhs);
+}
+
+template <typename E>
+VectorScale<E> operator*(typename E::value_type lhs, const VectorExpression<E> & rhs)
+{
+	return VectorScale<E>(rhs.Self(), lhs);
+}
+
+template <typename E>
+VectorQuotient<E> operator/(const VectorExpression<E> & lhs, typename E::value_type rhs)
+{
+	return VectorQuotient<E>(lhs.Self(), rhs);
+}
+
+#endif
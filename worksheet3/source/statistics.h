@@ -0,0 +1,78 @@
+/**
+ * Running summary statistics, so that large runs can report means and spreads
+ * without storing every value.
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cmath>
+#include <limits>
+
+/**
+ * Count, mean, variance, minimum and maximum of a stream of values. Uses
+ * Welford's update, which avoids the cancellation of the sum of squares
+ * formula. Two sets of statistics (e.g. from different threads) can be
+ * combined with Merge.
+ */
+struct RunningStatistics
+{
+	long long count;
+	double mean;
+	// Sum of squared differences from the mean.
+	double m2;
+	double min;
+	double max;
+
+	RunningStatistics() :
+		count(0), mean(0), m2(0),
+		min(std::numeric_limits<double>::infinity()),
+		max(-std::numeric_limits<double>::infinity())
+	{}
+
+	void Add(double value)
+	{
+		count++;
+		double delta = value - mean;
+		mean += delta / count;
+		m2 += delta * (value - mean);
+		if (value < min)
+			min = value;
+		if (value > max)
+			max = value;
+	}
+
+	void Merge(const RunningStatistics & other)
+	{
+		if (other.count == 0)
+			return;
+		if (count == 0)
+		{
+			*this = other;
+			return;
+		}
+
+		long long total = count + other.count;
+		double delta = other.mean - mean;
+		mean += delta * other.count / total;
+		m2 += other.m2 + delta * delta * ((double)count * other.count / total);
+		count = total;
+		if (other.min < min)
+			min = other.min;
+		if (other.max > max)
+			max = other.max;
+	}
+
+	// Sample variance, zero for fewer than two values.
+	double Variance() const
+	{
+		return count > 1 ? m2 / (count - 1) : 0;
+	}
+
+	double StandardDeviation() const
+	{
+		return std::sqrt(Variance());
+	}
+};
+
+#endif
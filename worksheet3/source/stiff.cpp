@@ -0,0 +1,283 @@
+/**
+ * Source code for a program comparing explicit and implicit integrators on a
+ * stiff variant of the worksheet3 oscillator, a heavily damped oscillator
+ *
+ * 	v' = -lambda x - (1 + lambda) v, x' = v
+ *
+ * whose solutions decay as e^-t and e^-(lambda t). For large lambda the second
+ * mode dies away almost at once but still limits the step size of explicit
+ * methods. The native Rosenbrock and BDF integrators (stiff.h) and the GSL
+ * implicit BDF stepper, which needs a real Jacobian, are compared against the
+ * Dormand-Prince integrator and GSL fourth order Runge-Kutta.
+ *
+ * Over long goal times the solution decays into the subnormal numbers, where
+ * arithmetic can be far slower (see fpenv.h). Only the absolute error is
+ * reported, which flushing them to zero barely changes, so the integrators run
+ * with subnormals flushed where that is measured to be faster.
+ *
+ * GSL version 1.16
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_odeiv2.h>
+#include "statevector.h"
+#include "dormandprince.h"
+#include "stiff.h"
+#include "../../common/fpenv.h"
+
+typedef StateVector<2> Vector;
+
+// Stiffness of the problem, set in main.
+double lambda = 1000;
+
+/**
+ * Derivative of the stiff problem, vec[0] = v and vec[1] = x. A class with a
+ * templated call, so that it can also be evaluated on dual numbers to find
+ * the Jacobian.
+ */
+struct Derivative
+{
+	/**
+	 * double t : Time to evaluate derivative.
+	 * StateVector y : v and x values to evaluate derivative at.
+	 * return : v' and x' evaluated at t and y.
+	 */
+	template <typename T>
+	StateVector<2, T> operator()(double t, const StateVector<2, T> & y) const
+	{
+		StateVector<2, T> temp;
+		temp[0] = -lambda * y[1] - (1 + lambda) * y[0];
+		temp[1] = y[0];
+		return temp;
+	}
+};
+
+/**
+ * Right hand side of the stiff problem in array form for GSL, templated so
+ * that GSL's Jacobian can be found with dual numbers.
+ */
+template <typename T>
+void Stiff(const T y[], T f[])
+{
+	f[0] = -lambda * y[1] - (1 + lambda) * y[0];
+	f[1] = y[0];
+}
+
+/**
+ * Analytic solution of the stiff problem with v = 1, x = 0 at t = 0.
+ *
+ * double t : time to evaluate solution.
+ * return : value of v and x at t.
+ */
+Vector Analytic(double t);
+
+/**
+ * GSL form of the derivative. params points to a Counter, which counts the
+ * calls made by GSL.
+ */
+int Function(double t, const double y[], double f[], void * params);
+
+/**
+ * GSL form of the Jacobian, filling dfdy (row major) and dfdt. Found with
+ * dual numbers.
+ */
+int Jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params);
+
+// Counts of GSL calls to Function and Jacobian.
+struct Counter
+{
+	long long evaluations;
+	long long jacobians;
+};
+
+/**
+ * Print the number of Jacobians and LU factorisations used by an implicit
+ * integrator, or dashes for the explicit one.
+ */
+template <typename Solver>
+void PrintLinearAlgebraCounts(const Solver & solver)
+{
+	printf("%-12lli%-12lli", solver.jacobians, solver.factorisations);
+}
+
+template <std::size_t N, typename T, typename F>
+void PrintLinearAlgebraCounts(const DormandPrince<N, T, F> & solver)
+{
+	printf("%-12s%-12s", "-", "-");
+}
+
+/**
+ * Run an adaptive integrator with the Apply interface to finalT, and print
+ * its result and counts.
+ *
+ * const char * name : name to print.
+ * Solver & solver : integrator.
+ * double finalT : goal time.
+ * return : number of accepted steps.
+ */
+template <typename Solver>
+long long RunNative(const char * name, Solver & solver, double finalT);
+
+/**
+ * Run a GSL stepper under an evolve object to finalT, and print its result
+ * and counts.
+ *
+ * const char * name : name to print.
+ * const gsl_odeiv2_step_type * type : GSL stepper.
+ * double absError, relError : error boundaries.
+ * double finalT : goal time.
+ */
+void RunGSL(const char * name, const gsl_odeiv2_step_type * type, double absError, double relError, double finalT);
+
+/**
+ * Main function, asks for stiffness, goal time and error boundaries and then
+ * compares the integrators, flushing subnormals to zero if it pays here.
+ */
+int main()
+{
+	printf("Please input stiffness lambda: ");
+	std::cin >> lambda;
+
+	double finalT;
+	printf("Please input goal time: ");
+	std::cin >> finalT;
+
+	double absError, relError;
+	printf("Please enter desired absolute error boundary: ");
+	std::cin >> absError;
+	printf("Please enter desired relative error boundary: ");
+	std::cin >> relError;
+
+	printf("Measuring floating point speed...\n");
+	FloatingPointProfile profile = MeasureFloatingPoint();
+	bool flush = profile.PreferFlush<double>();
+	printf("Subnormal arithmetic is %.1f times slower, %s.\n", profile.doublePrecision.subnormalPenalty,
+		flush ? "flushing subnormals to zero" : "keeping subnormals");
+
+	// Restores the previous mode when main returns.
+	FlushDenormals flushDenormals(flush);
+
+	typedef AutomaticJacobian<2, double, Derivative> ExactJacobian;
+	typedef FiniteDifferenceJacobian<2, double, Derivative> DifferenceJacobian;
+
+	printf("\n%-32s%-12s%-12s%-12s%-12s%-12s%-20s\n", "Method", "Steps", "Rejected", "Evals", "Jacobians", "LU", "Error");
+
+	DormandPrince<2, double, Derivative> explicitSolver(Derivative(), absError, relError);
+	RunNative("Dormand-Prince (explicit)", explicitSolver, finalT);
+
+	Rosenbrock<2, double, Derivative, ExactJacobian> rosenbrock(Derivative(), ExactJacobian(Derivative()), absError, relError);
+	RunNative("Rosenbrock, automatic J", rosenbrock, finalT);
+
+	DifferenceJacobian difference((Derivative()));
+	Rosenbrock<2, double, Derivative, DifferenceJacobian &> rosenbrockDifference(Derivative(), difference, absError, relError);
+	RunNative("Rosenbrock, difference J", rosenbrockDifference, finalT);
+	printf("%-32s%lli derivative evaluations for Jacobians\n", "", difference.evaluations);
+
+	BDF<2, double, Derivative, ExactJacobian> bdf(Derivative(), ExactJacobian(Derivative()), absError, relError);
+	RunNative("BDF, automatic J", bdf, finalT);
+
+	RunGSL("GSL rk4 (explicit)", gsl_odeiv2_step_rk4, absError, relError, finalT);
+	RunGSL("GSL msbdf", gsl_odeiv2_step_msbdf, absError, relError, finalT);
+
+	printf("Done!\n");
+
+	return 0;
+}
+
+Vector Analytic(double t)
+{
+	// x = (e^-t - e^-(lambda t))/(lambda - 1), v = x'.
+	Vector temp;
+	if (lambda == 1)
+	{
+		// Critically damped limit, x = t e^-t.
+		temp[0] = (1 - t) * std::exp(-t);
+		temp[1] = t * std::exp(-t);
+		return temp;
+	}
+	temp[0] = (-std::exp(-t) + lambda * std::exp(-lambda * t)) / (lambda - 1);
+	temp[1] = (std::exp(-t) - std::exp(-lambda * t)) / (lambda - 1);
+	return temp;
+}
+
+template <typename Solver>
+long long RunNative(const char * name, Solver & solver, double finalT)
+{
+	double t = 0;
+	double h = 1e-6;
+	Vector y(1, 0);
+
+	while (t < finalT)
+	{
+		if (solver.Apply(t, finalT, h, y) != 0)
+		{
+			printf("%s: critical failure.\n", name);
+			break;
+		}
+	}
+
+	Vector actual = Analytic(finalT);
+	double error = std::abs(y[1] - actual[1]);
+
+	printf("%-32s%-12lli%-12lli%-12lli", name, solver.accepted, solver.rejected, solver.evaluations);
+	PrintLinearAlgebraCounts(solver);
+	printf("%-20.3e\n", error);
+
+	return solver.accepted;
+}
+
+int Function(double t, const double y[], double f[], void * params)
+{
+	Counter * counter = (Counter *)params;
+	counter->evaluations++;
+	Stiff(y, f);
+	return GSL_SUCCESS;
+}
+
+int Jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params)
+{
+	Counter * counter = (Counter *)params;
+	counter->jacobians++;
+	double f[2];
+	DualJacobian<2, 2>(Stiff<Dual<double, 2> >, y, f, dfdy);
+	// The system doesn't depend on time explicitly.
+	dfdt[0] = 0;
+	dfdt[1] = 0;
+	return GSL_SUCCESS;
+}
+
+void RunGSL(const char * name, const gsl_odeiv2_step_type * type, double absError, double relError, double finalT)
+{
+	Counter counter = {0, 0};
+	gsl_odeiv2_system sys = {Function, Jacobian, 2, &counter};
+
+	gsl_odeiv2_step * step = gsl_odeiv2_step_alloc(type, 2);
+	gsl_odeiv2_control * control = gsl_odeiv2_control_y_new(absError, relError);
+	gsl_odeiv2_evolve * evolve = gsl_odeiv2_evolve_alloc(2);
+
+	double t = 0;
+	double h = 1e-6;
+	double y[2] = {1, 0};
+	long long steps = 0;
+
+	while (t < finalT)
+	{
+		if (gsl_odeiv2_evolve_apply(evolve, control, step, &sys, &t, finalT, &h, y) != GSL_SUCCESS)
+		{
+			printf("%s: critical failure.\n", name);
+			break;
+		}
+		steps++;
+	}
+
+	Vector actual = Analytic(finalT);
+
+	printf("%-32s%-12lli%-12s%-12lli%-12lli%-12s%-20.3e\n", name, steps, "-", counter.evaluations, counter.jacobians, "-", std::abs(y[1] - actual[1]));
+
+	gsl_odeiv2_step_free(step);
+	gsl_odeiv2_control_free(control);
+	gsl_odeiv2_evolve_free(evolve);
+}
@@ -0,0 +1,601 @@
+/**
+ * Implicit integrators for stiff systems of ODEs.
+ *
+ * A system is stiff when it has some components that decay much faster than
+ * the solution of interest changes. Explicit methods (Runge-Kutta,
+ * Dormand-Prince) are then limited by stability rather than accuracy and are
+ * forced to take tiny steps. Implicit methods are not, but need the Jacobian
+ * J = df/dy and the solution of linear systems with a matrix I - c h J.
+ *
+ * Two integrators are provided, both with the Apply interface of the
+ * Dormand-Prince integrator:
+ *
+ * Rosenbrock : the two stage ROS2 W-method (Verwer et al. 1999), which is
+ * 	L-stable and keeps second order for any approximation to J. The
+ * 	Jacobian is therefore reused across many steps, and the LU
+ * 	factorisation is reused as long as the step width is unchanged.
+ * BDF : variable order (1 to 5), variable step backward differentiation
+ * 	formulae with a modified Newton iteration. The Jacobian and LU
+ * 	factorisation are reused until Newton convergence becomes slow.
+ *
+ * The Jacobian is supplied by a function called as
+ * jacobian(double t, const StateVector<N, T> & y, double J[]) which fills J
+ * row major, J[i*N + j] = df_i/dy_j. AutomaticJacobian builds one from a
+ * derivative function templated over its number type, using dual numbers.
+ * FiniteDifferenceJacobian builds one from any derivative function.
+ */
+
+#ifndef STIFF_H
+#define STIFF_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include "statevector.h"
+#include "linearalgebra.h"
+#include "../../common/dual.h"
+
+/**
+ * Jacobian by forward differences of the derivative function, costing N
+ * extra derivative evaluations.
+ */
+template <std::size_t N, typename T, typename F>
+class FiniteDifferenceJacobian
+{
+public:
+	// Number of derivative evaluations used.
+	long long evaluations;
+
+	explicit FiniteDifferenceJacobian(F d) :
+		evaluations(0), d(d)
+	{}
+
+	void operator()(double t, const StateVector<N, T> & y, double J[])
+	{
+		StateVector<N, T> f0 = d(t, y);
+		StateVector<N, T> yShift = y;
+
+		for (std::size_t j = 0; j != N; j++)
+		{
+			double delta = std::sqrt(std::numeric_limits<double>::epsilon()) * std::max(1.0, std::abs((double)y[j]));
+			yShift[j] = y[j] + delta;
+			StateVector<N, T> f1 = d(t, yShift);
+			yShift[j] = y[j];
+
+			for (std::size_t i = 0; i != N; i++)
+				J[i*N + j] = (f1[i] - f0[i]) / delta;
+		}
+
+		evaluations += N + 1;
+	}
+
+private:
+	F d;
+};
+
+/**
+ * Exact Jacobian by forward mode automatic differentiation. The derivative is
+ * evaluated once on a state of dual numbers, with component j seeded along
+ * direction j, so every column of J comes from the same pass.
+ *
+ * F must accept a StateVector of Dual<T, N> as well as of T, for example a
+ * class with a templated operator().
+ */
+template <std::size_t N, typename T, typename F>
+class AutomaticJacobian
+{
+public:
+	// Number of (dual) derivative evaluations used.
+	long long evaluations;
+
+	explicit AutomaticJacobian(F d) :
+		evaluations(0), d(d)
+	{}
+
+	void operator()(double t, const StateVector<N, T> & y, double J[])
+	{
+		StateVector<N, Dual<T, N> > yDual;
+		for (std::size_t j = 0; j != N; j++)
+			yDual[j] = Dual<T, N>(y[j], j);
+
+		StateVector<N, Dual<T, N> > f = d(t, yDual);
+
+		for (std::size_t i = 0; i != N; i++)
+			for (std::size_t j = 0; j != N; j++)
+				J[i*N + j] = f[i].d[j];
+
+		evaluations++;
+	}
+
+private:
+	F d;
+};
+
+/**
+ * Root mean square of e relative to the error boundary absError +
+ * relError * |y|, as used by all the adaptive integrators.
+ */
+template <std::size_t N, typename T>
+double ScaledNorm(const StateVector<N, T> & e, const StateVector<N, T> & y, double absError, double relError)
+{
+	double sum = 0;
+	for (std::size_t i = 0; i != N; i++)
+	{
+		double scaled = e[i] / (absError + relError * std::abs((double)y[i]));
+		sum += scaled * scaled;
+	}
+	return std::sqrt(sum / N);
+}
+
+/**
+ * ROS2 Rosenbrock W-method with adaptive step width.
+ *
+ * F is the derivative, J the Jacobian function (see top of file).
+ */
+template <std::size_t N, typename T, typename F, typename J>
+class Rosenbrock
+{
+public:
+	// Counts of steps, derivative and Jacobian evaluations and LU
+	// factorisations.
+	long long accepted;
+	long long rejected;
+	long long evaluations;
+	long long jacobians;
+	long long factorisations;
+
+	/**
+	 * F d : derivative function for the problem.
+	 * J jacobian : Jacobian function for the problem.
+	 * double absError : absolute error boundary.
+	 * double relError : relative error boundary.
+	 */
+	Rosenbrock(F d, J jacobian, double absError, double relError) :
+		accepted(0), rejected(0), evaluations(0), jacobians(0), factorisations(0),
+		d(d), jacobian(jacobian), absError(absError), relError(relError),
+		haveJacobian(false), factoredH(0), jacobianAge(0)
+	{}
+
+	/**
+	 * Advance y by one accepted step, as DormandPrince::Apply.
+	 *
+	 * return : 0 on success, 1 if the step width became too small, the
+	 * 	matrix was singular or the error estimate is not finite.
+	 */
+	int Apply(double & t, double t1, double & h, StateVector<N, T> & y)
+	{
+		while (true)
+		{
+			bool final = false;
+			if ((t + h - t1) * h > 0)
+			{
+				h = t1 - t;
+				final = true;
+			}
+
+			if (!haveJacobian || jacobianAge >= maxJacobianAge)
+			{
+				jacobian(t, y, jac);
+				jacobians++;
+				haveJacobian = true;
+				jacobianAge = 0;
+				factoredH = 0;
+			}
+
+			if (h != factoredH)
+			{
+				// M = I - gamma h J.
+				for (std::size_t i = 0; i != N*N; i++)
+					lu[i] = -gamma * h * jac[i];
+				for (std::size_t i = 0; i != N; i++)
+					lu[i*N + i] += 1;
+				if (LUDecompose(lu, N, pivot) != 0)
+					return 1;
+				factorisations++;
+				factoredH = h;
+			}
+
+			// (I - gamma h J) k1 = f(t, y)
+			StateVector<N, T> k1 = d(t, y);
+			LUSolve(lu, N, pivot, k1.data);
+
+			// (I - gamma h J) k2 = f(t + h, y + h k1) - 2 k1
+			StateVector<N, T> stage = y + h * k1;
+			StateVector<N, T> k2 = d(t + h, stage) - 2.0 * k1;
+			LUSolve(lu, N, pivot, k2.data);
+
+			evaluations += 2;
+
+			StateVector<N, T> yNew = y + (1.5 * h) * k1 + (0.5 * h) * k2;
+
+			// Difference from the embedded first order solution y + h k1.
+			StateVector<N, T> error = (0.5 * h) * (k1 + k2);
+			double err = ScaledNorm(error, yNew, absError, relError);
+
+			// The solution has blown up, no step width will help.
+			if (!std::isfinite(err))
+				return 1;
+
+			double factor = 0.9 / std::sqrt(std::max(err, 1e-10));
+
+			if (err <= 1)
+			{
+				t = final ? t1 : t + h;
+				y = yNew;
+				accepted++;
+				jacobianAge++;
+
+				// Keep the width (and the factorisation) unless the
+				// change is worthwhile.
+				if (factor > 1.2)
+					h *= std::min(factor, 5.0);
+				else if (factor < 1)
+					h *= std::max(factor, 0.2);
+				return 0;
+			}
+
+			// Rejected, refresh the Jacobian as well as shrinking the step.
+			rejected++;
+			haveJacobian = false;
+			h *= std::max(factor, 0.2);
+
+			if (std::abs(h) <= 10 * std::numeric_limits<double>::epsilon() * std::abs(t))
+				return 1;
+		}
+	}
+
+private:
+	F d;
+	J jacobian;
+	double absError;
+	double relError;
+
+	double jac[N*N];
+	double lu[N*N];
+	int pivot[N];
+	bool haveJacobian;
+	double factoredH;
+	int jacobianAge;
+
+	// 1 + 1/sqrt(2), giving L-stability.
+	static constexpr double gamma = 1.7071067811865475;
+	static const int maxJacobianAge = 50;
+};
+
+/**
+ * Variable order, variable step BDF integrator.
+ *
+ * The coefficients for the current (uneven) grid of past times are found by
+ * differentiating the Lagrange interpolating polynomial, and the predictor
+ * is the same polynomial extrapolated. The local error of order k is
+ * estimated as |corrector - predictor|/(k + 1).
+ *
+ * F is the derivative, J the Jacobian function (see top of file).
+ */
+template <std::size_t N, typename T, typename F, typename J>
+class BDF
+{
+public:
+	// Counts of steps, derivative and Jacobian evaluations, LU
+	// factorisations and Newton iterations.
+	long long accepted;
+	long long rejected;
+	long long evaluations;
+	long long jacobians;
+	long long factorisations;
+	long long iterations;
+
+	// Order used for the last accepted step.
+	int order;
+
+	/**
+	 * F d : derivative function for the problem.
+	 * J jacobian : Jacobian function for the problem.
+	 * double absError : absolute error boundary.
+	 * double relError : relative error boundary.
+	 */
+	BDF(F d, J jacobian, double absError, double relError) :
+		accepted(0), rejected(0), evaluations(0), jacobians(0), factorisations(0), iterations(0),
+		order(1), d(d), jacobian(jacobian), absError(absError), relError(relError),
+		haveJacobian(false), jacobianCurrent(false), factoredAlpha(0), stepsAtOrder(0)
+	{}
+
+	/**
+	 * Advance y by one accepted step, as DormandPrince::Apply. The state
+	 * must only be changed through Apply, as the past steps are kept.
+	 *
+	 * return : 0 on success, 1 if the step width became too small, the
+	 * 	matrix was singular or the error estimate is not finite.
+	 */
+	int Apply(double & t, double t1, double & h, StateVector<N, T> & y)
+	{
+		if (times.empty())
+		{
+			times.push_back(t);
+			history.push_back(y);
+		}
+
+		while (true)
+		{
+			bool final = false;
+			if ((t + h - t1) * h > 0)
+			{
+				h = t1 - t;
+				final = true;
+			}
+
+			double tNew = final ? t1 : t + h;
+			int k = std::min<int>(order, times.size());
+
+			// Predictor: extrapolate through k + 1 past points (or as
+			// many as there are).
+			StateVector<N, T> predictor = Extrapolate(tNew, std::min<int>(k + 1, times.size()));
+
+			// Corrector coefficients, alpha[0] multiplies the new value.
+			double alpha[maxOrder + 1];
+			Coefficients(tNew, k, alpha);
+
+			StateVector<N, T> constant = 0.0 * y;
+			for (int j = 1; j <= k; j++)
+				constant += alpha[j] * history[history.size() - j];
+
+			int status = Newton(tNew, alpha[0], constant, predictor);
+
+			if (status == 2)
+				return 1;
+
+			if (status == 0)
+			{
+				StateVector<N, T> error = (1.0 / (k + 1)) * (corrector - predictor);
+				double err = ScaledNorm(error, corrector, absError, relError);
+
+				if (!std::isfinite(err))
+					return 1;
+
+				if (err <= 1)
+				{
+					t = tNew;
+					y = corrector;
+					times.push_back(t);
+					history.push_back(y);
+					if (times.size() > (std::size_t)maxOrder + 2)
+					{
+						times.erase(times.begin());
+						history.erase(history.begin());
+					}
+					accepted++;
+					stepsAtOrder++;
+					jacobianCurrent = false;
+
+					h *= ChooseOrder(tNew, k, err);
+					return 0;
+				}
+
+				// Rejected on accuracy.
+				rejected++;
+				h *= std::max(0.2, 0.9 * std::pow(err, -1.0 / (k + 1)));
+				stepsAtOrder = 0;
+			}
+			else
+			{
+				// Newton failed with a current Jacobian, so shrink.
+				rejected++;
+				h *= 0.25;
+			}
+
+			if (std::abs(h) <= 10 * std::numeric_limits<double>::epsilon() * std::abs(t))
+				return 1;
+		}
+	}
+
+private:
+	static const int maxOrder = 5;
+
+	F d;
+	J jacobian;
+	double absError;
+	double relError;
+
+	// Past times and states, most recent last.
+	std::vector<double> times;
+	std::vector<StateVector<N, T> > history;
+
+	StateVector<N, T> corrector;
+
+	double jac[N*N];
+	double lu[N*N];
+	int pivot[N];
+	bool haveJacobian;
+	// Whether the Jacobian was evaluated during the current step.
+	bool jacobianCurrent;
+	double factoredAlpha;
+	int stepsAtOrder;
+
+	/**
+	 * Value at time tNew of the polynomial through the last points past
+	 * states.
+	 */
+	StateVector<N, T> Extrapolate(double tNew, int points) const
+	{
+		std::size_t last = times.size() - 1;
+		StateVector<N, T> result = 0.0 * history[last];
+
+		for (int j = 0; j != points; j++)
+		{
+			double basis = 1;
+			for (int m = 0; m != points; m++)
+				if (m != j)
+					basis *= (tNew - times[last - m]) / (times[last - j] - times[last - m]);
+			result += basis * history[last - j];
+		}
+
+		return result;
+	}
+
+	/**
+	 * BDF coefficients of order k on the nodes tNew, times[last], ...,
+	 * times[last - k + 1]: the derivatives at tNew of the Lagrange basis
+	 * polynomials.
+	 */
+	void Coefficients(double tNew, int k, double alpha[]) const
+	{
+		std::size_t last = times.size() - 1;
+		// nodes[0] = tNew, nodes[j] = times[last - j + 1].
+		double nodes[maxOrder + 1];
+		nodes[0] = tNew;
+		for (int j = 1; j <= k; j++)
+			nodes[j] = times[last - j + 1];
+
+		alpha[0] = 0;
+		for (int m = 1; m <= k; m++)
+			alpha[0] += 1 / (nodes[0] - nodes[m]);
+
+		for (int j = 1; j <= k; j++)
+		{
+			double numerator = 1;
+			double denominator = 1;
+			for (int m = 0; m <= k; m++)
+			{
+				if (m == j)
+					continue;
+				if (m != 0)
+					numerator *= nodes[0] - nodes[m];
+				denominator *= nodes[j] - nodes[m];
+			}
+			alpha[j] = numerator / denominator;
+		}
+	}
+
+	/**
+	 * Solve alpha0 y + constant = f(tNew, y) for the corrector by modified
+	 * Newton iteration, starting from the predictor.
+	 *
+	 * return : 0 if converged, 1 if not, 2 if the matrix was singular.
+	 */
+	int Newton(double tNew, double alpha0, const StateVector<N, T> & constant, const StateVector<N, T> & predictor)
+	{
+		while (true)
+		{
+			if (!haveJacobian)
+			{
+				jacobian(tNew, predictor, jac);
+				jacobians++;
+				haveJacobian = true;
+				jacobianCurrent = true;
+				factoredAlpha = 0;
+			}
+
+			// Refactorise only when alpha0 has moved by more than 30%.
+			if (factoredAlpha == 0 || std::abs(alpha0 - factoredAlpha) > 0.3 * factoredAlpha)
+			{
+				// M = alpha0 I - J.
+				for (std::size_t i = 0; i != N*N; i++)
+					lu[i] = -jac[i];
+				for (std::size_t i = 0; i != N; i++)
+					lu[i*N + i] += alpha0;
+				if (LUDecompose(lu, N, pivot) != 0)
+					return 2;
+				factorisations++;
+				factoredAlpha = alpha0;
+			}
+
+			corrector = predictor;
+			double previous = 0;
+			bool converged = false;
+
+			for (int i = 0; i != 4; i++)
+			{
+				StateVector<N, T> residual = d(tNew, corrector) - alpha0 * corrector - constant;
+				evaluations++;
+				iterations++;
+
+				LUSolve(lu, N, pivot, residual.data);
+				corrector += residual;
+
+				double size = ScaledNorm(residual, corrector, absError, relError);
+				if (size <= 0.05)
+				{
+					converged = true;
+					break;
+				}
+				// Diverging or converging too slowly.
+				if (i > 0 && size > 0.9 * previous)
+					break;
+				previous = size;
+			}
+
+			if (converged)
+				return 0;
+
+			if (jacobianCurrent)
+				return 1;
+
+			// Try again with a fresh Jacobian.
+			haveJacobian = false;
+		}
+	}
+
+	/**
+	 * Choose the order for the next step, comparing error estimates at the
+	 * neighbouring orders once enough steps have been taken at this one.
+	 *
+	 * return : factor to change the step width by.
+	 */
+	double ChooseOrder(double tNew, int k, double err)
+	{
+		double best = 0.9 * std::pow(std::max(err, 1e-10), -1.0 / (k + 1));
+		int bestOrder = k;
+
+		// times now includes tNew, compare the corrector against
+		// extrapolations of other orders from the earlier points.
+		if (stepsAtOrder > k)
+		{
+			for (int q = k - 1; q <= k + 1; q += 2)
+			{
+				if (q < 1 || q > maxOrder || (std::size_t)(q + 2) > times.size())
+					continue;
+
+				StateVector<N, T> estimate = ExtrapolateExcludingLast(tNew, q + 1) - corrector;
+				double errQ = ScaledNorm(estimate, corrector, absError, relError) / (q + 1);
+				double factor = 0.9 * std::pow(std::max(errQ, 1e-10), -1.0 / (q + 1));
+				if (factor > best * 1.1)
+				{
+					best = factor;
+					bestOrder = q;
+				}
+			}
+		}
+
+		if (bestOrder != order || k != order)
+			stepsAtOrder = 0;
+		order = bestOrder;
+
+		if (best > 1.2)
+			return std::min(best, 5.0);
+		if (best < 1)
+			return std::max(best, 0.2);
+		return 1;
+	}
+
+	// As Extrapolate, but ignoring the point just added.
+	StateVector<N, T> ExtrapolateExcludingLast(double tNew, int points) const
+	{
+		std::size_t last = times.size() - 2;
+		StateVector<N, T> result = 0.0 * history[last];
+
+		for (int j = 0; j != points; j++)
+		{
+			double basis = 1;
+			for (int m = 0; m != points; m++)
+				if (m != j)
+					basis *= (tNew - times[last - m]) / (times[last - j] - times[last - m]);
+			result += basis * history[last - j];
+		}
+
+		return result;
+	}
+};
+
+#endif
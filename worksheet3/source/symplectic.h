@@ -0,0 +1,109 @@
+/**
+ * Symplectic integrators for separable Hamiltonian systems, that is systems
+ * which can be written as q' = p, p' = a(t, q).
+ *
+ * Runge-Kutta methods do not preserve the energy of such a system, and the
+ * energy error grows steadily with the number of steps. Symplectic methods
+ * instead conserve a nearby "shadow" Hamiltonian exactly, so the energy error
+ * stays bounded for any number of steps and much larger steps can be used on
+ * long runs.
+ *
+ * The basic method is velocity Verlet (leapfrog). Higher orders are built by
+ * composing Verlet steps with the sub step weights given below, see
+ * H. Yoshida, Construction of higher order symplectic integrators, Phys. Lett.
+ * A 150 (1990) 262.
+ */
+
+#ifndef SYMPLECTIC_H
+#define SYMPLECTIC_H
+
+#include <cstddef>
+#include "statevector.h"
+
+// Second order velocity Verlet, a single sub step.
+static const double VerletWeights[1] = {1.0};
+
+// Fourth order Forest-Ruth (Yoshida triple jump):
+// w1 = 1/(2 - 2^(1/3)), w0 = -2^(1/3)/(2 - 2^(1/3)).
+static const double ForestRuthWeights[3] = {
+	1.3512071919596578, -1.7024143839193153, 1.3512071919596578};
+
+// Sixth order Yoshida composition (solution A).
+static const double YoshidaSixthWeights[7] = {
+	0.784513610477560, 0.235573213359357, -1.17767998417887,
+	1.315186320683906,
+	-1.17767998417887, 0.235573213359357, 0.784513610477560};
+
+/**
+ * Function that performs one velocity Verlet (kick-drift-kick) step. The
+ * acceleration at the end of the step is kept for the start of the next, so
+ * each step costs a single acceleration evaluation.
+ *
+ * accel : acceleration function, called as accel(double t, q).
+ * StateVector & q : position at start of step, updated to end of step.
+ * StateVector & p : velocity at start of step, updated to end of step.
+ * StateVector & a : acceleration at start of step, updated to end of step.
+ * double t : value of t at start of step.
+ * double h : width of step.
+ */
+template <typename A, std::size_t N, typename T>
+void VerletStep(A accel, StateVector<N, T> & q, StateVector<N, T> & p, StateVector<N, T> & a, double t, double h)
+{
+	p += (h/2) * a;
+	q += h * p;
+	a = accel(t + h, q);
+	p += (h/2) * a;
+}
+
+/**
+ * Function that performs one step of a composition method, made up of
+ * Verlet sub steps of widths weights[i] * h.
+ *
+ * accel : acceleration function, called as accel(double t, q).
+ * StateVector & q : position, updated to end of step.
+ * StateVector & p : velocity, updated to end of step.
+ * StateVector & a : acceleration at (t, q), updated to end of step.
+ * double t : value of t at start of step.
+ * double h : width of step.
+ * const double weights[] : sub step weights, these sum to 1.
+ * int stages : number of weights.
+ */
+template <typename A, std::size_t N, typename T>
+void CompositionStep(A accel, StateVector<N, T> & q, StateVector<N, T> & p, StateVector<N, T> & a, double t, double h, const double weights[], int stages)
+{
+	for (int i = 0; i != stages; i++)
+	{
+		VerletStep(accel, q, p, a, t, weights[i] * h);
+		t += weights[i] * h;
+	}
+}
+
+/**
+ * Function that applies a composition method over intervals steps from
+ * startT to finalT.
+ *
+ * accel : acceleration function, called as accel(double t, q).
+ * StateVector & q : initial position, updated to the position at finalT.
+ * StateVector & p : initial velocity, updated to the velocity at finalT.
+ * double startT : start time for the initial conditions.
+ * long long intervals : number of intervals to use.
+ * double finalT : goal time.
+ * const double weights[] : sub step weights of the method.
+ * int stages : number of weights.
+ */
+template <typename A, std::size_t N, typename T>
+void SymplecticIntegrate(A accel, StateVector<N, T> & q, StateVector<N, T> & p, double startT, long long intervals, double finalT, const double weights[], int stages)
+{
+	double h = (finalT - startT)/intervals;
+	double t = startT;
+	StateVector<N, T> a = accel(t, q);
+
+	// Invariant: we have moved to time t = startT + i*h.
+	for (long long i = 0; i != intervals; i++)
+	{
+		CompositionStep(accel, q, p, a, t, h, weights, stages);
+		t += h;
+	}
+}
+
+#endif
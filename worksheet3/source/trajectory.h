@@ -0,0 +1,550 @@
+/**
+ * Binary trajectory files.
+ *
+ * Text output costs a formatted conversion per number on writing and a parse
+ * per number on reading, and takes about 20 bytes per value. This format
+ * stores each value as a raw double instead, so writing is a copy and reading
+ * is a memory access.
+ *
+ * A file is a header (system, method, step width or tolerance, column names),
+ * followed by blocks of rows, followed by an index. Within a block the values
+ * are stored column by column, so a block of the time column, or of any
+ * other, is contiguous. Rows are collected into a block in memory and each
+ * full block is written with a single fwrite.
+ *
+ * Column 0 is always time, which must not decrease from row to row. The index
+ * holds the first and last time of each block and where the block starts, so
+ * the reader finds the rows for a time range with a binary search over the
+ * blocks and then one within a block. The reader maps the file into memory
+ * (mmap), so only the blocks that are actually read are loaded from disk.
+ *
+ * Blocks can optionally be compressed (see compression.h): time with
+ * delta-of-delta encoding and the other columns by XOR with a prediction.
+ * Each block is compressed on its own, so random access only decodes the
+ * blocks it touches.
+ *
+ * Values are stored in the byte order of the machine which wrote them.
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "compression.h"
+
+// Largest number of columns, including time.
+#define TRAJECTORY_MAX_COLUMNS 16
+
+/**
+ * Header at the start of a trajectory file. Every field is a multiple of 8
+ * bytes, so the blocks which follow it are aligned for doubles.
+ *
+ * magic : "TRAJ" and the format version.
+ * columns : number of columns, including time.
+ * blockRows : rows in every block except possibly the last.
+ * rows : total number of rows.
+ * blocks : number of blocks.
+ * compressed : 1 if blocks are compressed, 0 if they are raw doubles.
+ * indexOffset : position of the index in the file.
+ * parameter : step width or tolerance of the method.
+ * system, method : names, null terminated.
+ * names : column names, null terminated.
+ */
+struct TrajectoryHeader
+{
+	char magic[8];
+	unsigned long long columns;
+	unsigned long long blockRows;
+	unsigned long long rows;
+	unsigned long long blocks;
+	unsigned long long compressed;
+	unsigned long long indexOffset;
+	double parameter;
+	char system[64];
+	char method[64];
+	char names[TRAJECTORY_MAX_COLUMNS][16];
+};
+
+/**
+ * Index entry for one block.
+ *
+ * start, end : times of the first and last rows of the block.
+ * offset : position of the block in the file.
+ * rows : number of rows in the block.
+ * bytes : size of the block in the file.
+ */
+struct TrajectoryIndex
+{
+	double start;
+	double end;
+	unsigned long long offset;
+	unsigned long long rows;
+	unsigned long long bytes;
+};
+
+static const char TrajectoryMagic[8] = {'T', 'R', 'A', 'J', 0, 0, 0, 2};
+
+/**
+ * Writes rows to a trajectory file.
+ */
+class TrajectoryWriter
+{
+public:
+	/**
+	 * Create the file and write a provisional header. The header is
+	 * completed, and the index written, by Close.
+	 *
+	 * std::string filename : output filename.
+	 * std::string system : name of the system of ODEs.
+	 * std::string method : name of the integration method.
+	 * double parameter : step width or tolerance of the method.
+	 * const std::vector<std::string> & names : column names, the first
+	 * 	being time.
+	 * bool compress : compress blocks.
+	 * std::size_t blockRows : rows per block, at least 1. With 0 no file is
+	 * 	created.
+	 */
+	TrajectoryWriter(std::string filename, std::string system, std::string method, double parameter, const std::vector<std::string> & names, bool compress = false, std::size_t blockRows = 4096) :
+		count(0), failed(false), closed(false)
+	{
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TrajectoryMagic, sizeof(header.magic));
+		header.columns = std::min(names.size(), (std::size_t)TRAJECTORY_MAX_COLUMNS);
+		header.blockRows = blockRows;
+		header.compressed = compress;
+		header.parameter = parameter;
+		strncpy(header.system, system.c_str(), sizeof(header.system) - 1);
+		strncpy(header.method, method.c_str(), sizeof(header.method) - 1);
+		for (std::size_t c = 0; c != header.columns; c++)
+			strncpy(header.names[c], names[c].c_str(), sizeof(header.names[c]) - 1);
+
+		block.resize(header.columns * blockRows);
+
+		file = blockRows > 0 ? fopen(filename.c_str(), "wb") : 0;
+		if (file)
+			Put(&header, sizeof(header), 1);
+		offset = sizeof(header);
+	}
+
+	~TrajectoryWriter()
+	{
+		Close();
+	}
+
+	/**
+	 * return : true if the file was created.
+	 */
+	bool IsOpen() const
+	{
+		return file != 0;
+	}
+
+	/**
+	 * Add a row. Dropped if the file couldn't be created or is closed.
+	 *
+	 * const double row[] : one value per column, row[0] being time.
+	 */
+	void Write(const double row[])
+	{
+		if (!file)
+			return;
+
+		for (std::size_t c = 0; c != header.columns; c++)
+			block[c * header.blockRows + count] = row[c];
+
+		header.rows++;
+		if (++count == header.blockRows)
+			Flush();
+	}
+
+	/**
+	 * Write the last block, the index and the final header, and close the
+	 * file. Further calls do nothing.
+	 *
+	 * return : false if the file was never created or any write failed
+	 * 	(e.g. the disk is full), in which case the file is incomplete.
+	 */
+	bool Close()
+	{
+		if (!file)
+			return !failed && closed;
+
+		Flush();
+
+		header.blocks = index.size();
+		header.indexOffset = offset;
+		if (!index.empty())
+			Put(&index[0], sizeof(TrajectoryIndex), index.size());
+
+		if (fseek(file, 0, SEEK_SET) != 0)
+			failed = true;
+		Put(&header, sizeof(header), 1);
+
+		if (fclose(file) != 0)
+			failed = true;
+		file = 0;
+		closed = true;
+
+		return !failed;
+	}
+
+private:
+	FILE * file;
+	TrajectoryHeader header;
+	// Rows of the current block, column by column.
+	std::vector<double> block;
+	// Rows in the current block.
+	std::size_t count;
+	// Current block once compressed.
+	std::vector<unsigned char> bytes;
+	std::vector<TrajectoryIndex> index;
+	// Position of the next block.
+	unsigned long long offset;
+	// Whether any write has failed, and whether the file has been closed.
+	bool failed;
+	bool closed;
+
+	void Put(const void * values, std::size_t size, std::size_t count)
+	{
+		if (fwrite(values, size, count, file) != count)
+			failed = true;
+	}
+
+	void Flush()
+	{
+		if (count == 0 || !file)
+			return;
+
+		TrajectoryIndex entry = {block[0], block[count - 1], offset, count, header.columns * count * sizeof(double)};
+
+		if (header.compressed)
+		{
+			bytes.clear();
+			BitWriter out(bytes);
+			for (std::size_t c = 0; c != header.columns; c++)
+			{
+				const double * column = &block[c * header.blockRows];
+				if (c == 0)
+				{
+					DeltaEncoder encoder;
+					for (std::size_t r = 0; r != count; r++)
+						encoder.Encode(out, column[r]);
+				}
+				else
+				{
+					XorEncoder encoder;
+					for (std::size_t r = 0; r != count; r++)
+						encoder.Encode(out, column[r]);
+				}
+			}
+			out.Flush();
+
+			// Pad to whole doubles, so the index after the last block is
+			// aligned for reading in place.
+			bytes.resize((bytes.size() + 7) & ~(std::size_t)7);
+			Put(&bytes[0], 1, bytes.size());
+			entry.bytes = bytes.size();
+		}
+		else if (count == header.blockRows)
+		{
+			Put(&block[0], sizeof(double), block.size());
+		}
+		else
+		{
+			// Short last block, without the unused end of each column.
+			for (std::size_t c = 0; c != header.columns; c++)
+				Put(&block[c * header.blockRows], sizeof(double), count);
+		}
+
+		index.push_back(entry);
+		offset += entry.bytes;
+		count = 0;
+	}
+
+	TrajectoryWriter(const TrajectoryWriter &);
+	TrajectoryWriter & operator=(const TrajectoryWriter &);
+};
+
+/**
+ * Random access to a trajectory file, mapped into memory. Compressed blocks
+ * are decoded into a cache of one block when first read, so a reader of a
+ * compressed file must only be used by one thread at a time.
+ */
+class TrajectoryReader
+{
+public:
+	/**
+	 * Map a file and check its header and every index entry, so that no
+	 * read can go outside the mapping. If this fails IsOpen is false.
+	 *
+	 * std::string filename : trajectory file.
+	 */
+	explicit TrajectoryReader(std::string filename) :
+		data(0), size(0), header(0), index(0), cached(-1), corrupt(false)
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+
+		struct stat info;
+		if (fstat(fd, &info) == 0 && (std::size_t)info.st_size >= sizeof(TrajectoryHeader))
+		{
+			size = info.st_size;
+			void * map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map != MAP_FAILED)
+				data = (const char *)map;
+		}
+		close(fd);
+
+		if (!data)
+			return;
+
+		header = (const TrajectoryHeader *)data;
+		if (memcmp(header->magic, TrajectoryMagic, sizeof(header->magic)) != 0
+			|| header->columns == 0 || header->columns > TRAJECTORY_MAX_COLUMNS
+			|| header->blockRows == 0
+			|| header->indexOffset < sizeof(TrajectoryHeader) || header->indexOffset > size
+			|| header->indexOffset % sizeof(double) != 0
+			|| header->blocks > (size - header->indexOffset) / sizeof(TrajectoryIndex))
+		{
+			Unmap();
+			return;
+		}
+		index = (const TrajectoryIndex *)(data + header->indexOffset);
+
+		if (!ValidIndex())
+		{
+			Unmap();
+			return;
+		}
+	}
+
+	~TrajectoryReader()
+	{
+		Unmap();
+	}
+
+	/**
+	 * return : true if the file was mapped and is a trajectory file.
+	 */
+	bool IsOpen() const
+	{
+		return data != 0;
+	}
+
+	std::string System() const
+	{
+		return header->system;
+	}
+
+	std::string Method() const
+	{
+		return header->method;
+	}
+
+	/**
+	 * return : step width or tolerance of the method.
+	 */
+	double Parameter() const
+	{
+		return header->parameter;
+	}
+
+	/**
+	 * return : true if blocks are compressed.
+	 */
+	bool Compressed() const
+	{
+		return header->compressed != 0;
+	}
+
+	/**
+	 * return : true if a compressed block read so far was corrupt, its
+	 * 	undecodable values being NaN.
+	 */
+	bool Corrupt() const
+	{
+		return corrupt;
+	}
+
+	std::size_t Columns() const
+	{
+		return header->columns;
+	}
+
+	std::string Name(std::size_t column) const
+	{
+		return header->names[column];
+	}
+
+	std::size_t Rows() const
+	{
+		return header->rows;
+	}
+
+	/**
+	 * Value of one column of a row.
+	 *
+	 * std::size_t row : row, less than Rows().
+	 * std::size_t column : column, 0 for time.
+	 */
+	double Value(std::size_t row, std::size_t column) const
+	{
+		return Column(row / header->blockRows, column)[row % header->blockRows];
+	}
+
+	/**
+	 * Find the first row at or after a time.
+	 *
+	 * double t : time.
+	 * return : row, or Rows() if every row is before t.
+	 */
+	std::size_t Find(double t) const
+	{
+		// First block which ends at or after t.
+		std::size_t lo = 0, hi = header->blocks;
+		while (lo < hi)
+		{
+			std::size_t mid = (lo + hi)/2;
+			if (index[mid].end < t)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == header->blocks)
+			return header->rows;
+
+		const double * time = Column(lo, 0);
+		return lo * header->blockRows + (std::lower_bound(time, time + index[lo].rows, t) - time);
+	}
+
+	/**
+	 * Visit every row with a time in [t0, t1], in order.
+	 *
+	 * double t0, t1 : time range.
+	 * visit : called as visit(const double row[]) with one value per
+	 * 	column.
+	 * return : number of rows visited.
+	 */
+	template <typename Visitor>
+	std::size_t Range(double t0, double t1, Visitor visit) const
+	{
+		std::vector<double> row(header->columns);
+		std::size_t visited = 0;
+
+		for (std::size_t i = Find(t0); i < header->rows; visited++)
+		{
+			std::size_t block = i / header->blockRows;
+			std::size_t r = i % header->blockRows;
+			if (Column(block, 0)[r] > t1)
+				break;
+
+			for (std::size_t c = 0; c != header->columns; c++)
+				row[c] = Column(block, c)[r];
+			visit((const double *)&row[0]);
+			i++;
+		}
+
+		return visited;
+	}
+
+private:
+	const char * data;
+	std::size_t size;
+	const TrajectoryHeader * header;
+	const TrajectoryIndex * index;
+	// Decoded compressed block, and its number (-1 for none).
+	mutable std::vector<double> cache;
+	mutable long long cached;
+	// Whether any block decoded was corrupt.
+	mutable bool corrupt;
+
+	/**
+	 * Values of one column of a block, decoding the block if it is
+	 * compressed and not already cached.
+	 */
+	const double * Column(std::size_t block, std::size_t column) const
+	{
+		const TrajectoryIndex & entry = index[block];
+		if (!header->compressed)
+			return (const double *)(data + entry.offset) + column * entry.rows;
+
+		if (cached != (long long)block)
+		{
+			cache.resize(header->columns * entry.rows);
+			BitReader in((const unsigned char *)data + entry.offset, entry.bytes);
+			for (std::size_t c = 0; c != header->columns; c++)
+			{
+				double * values = &cache[c * entry.rows];
+				if (c == 0)
+				{
+					DeltaDecoder decoder;
+					for (std::size_t r = 0; r != entry.rows; r++)
+						values[r] = decoder.Decode(in);
+				}
+				else
+				{
+					XorDecoder decoder;
+					for (std::size_t r = 0; r != entry.rows; r++)
+						values[r] = decoder.Decode(in);
+					if (decoder.corrupt)
+						corrupt = true;
+				}
+			}
+			cached = block;
+		}
+		return &cache[column * entry.rows];
+	}
+
+	/**
+	 * Check that every block lies between the header and the index, holds
+	 * blockRows rows (the last at least one and at most blockRows), and for
+	 * raw blocks is exactly the size of its rows, and that the rows add up
+	 * to the header's count.
+	 */
+	bool ValidIndex() const
+	{
+		unsigned long long rows = 0;
+
+		for (std::size_t b = 0; b != header->blocks; b++)
+		{
+			const TrajectoryIndex & entry = index[b];
+			bool last = b + 1 == header->blocks;
+
+			if (entry.offset < sizeof(TrajectoryHeader) || entry.offset > header->indexOffset
+				|| entry.bytes > header->indexOffset - entry.offset
+				|| entry.rows == 0 || entry.rows > header->blockRows
+				|| (!last && entry.rows != header->blockRows))
+				return false;
+
+			if (!header->compressed && (entry.offset % sizeof(double) != 0
+				|| entry.bytes != header->columns * entry.rows * sizeof(double)))
+				return false;
+
+			rows += entry.rows;
+		}
+
+		return rows == header->rows;
+	}
+
+	void Unmap()
+	{
+		if (data)
+			munmap((void *)data, size);
+		data = 0;
+	}
+
+	TrajectoryReader(const TrajectoryReader &);
+	TrajectoryReader & operator=(const TrajectoryReader &);
+};
+
+#endif
@@ -0,0 +1,139 @@
+/**
+ * Work stealing, for parallel loops whose iterations have very uneven cost,
+ * such as adaptive integrations of trajectories from different initial
+ * conditions.
+ *
+ * ParallelFor (see parallel.h) gives each thread one fixed shard, so a shard
+ * full of expensive iterations keeps its thread busy long after the others
+ * have finished. Here the range is cut into chunks and each thread starts
+ * with a deque of the chunks of its own shard. A thread takes chunks from the
+ * front of its own deque, in order, and once that is empty steals from the
+ * back of another thread's deque, taking the work furthest from what the
+ * owner is doing. Threads only meet when stealing, so with chunks of a few
+ * iterations the cost of a steal is small against the work it balances.
+ */
+
+#ifndef WORKSTEALING_H
+#define WORKSTEALING_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "parallel.h"
+
+/**
+ * Deque of chunks [begin, end) belonging to one thread.
+ */
+class WorkStealingQueue
+{
+public:
+	void Push(std::size_t begin, std::size_t end)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		chunks.push_back(Chunk(begin, end));
+	}
+
+	// Take the next chunk in order, for the owner.
+	bool Pop(std::size_t & begin, std::size_t & end)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (chunks.empty())
+			return false;
+		begin = chunks.front().first;
+		end = chunks.front().second;
+		chunks.pop_front();
+		return true;
+	}
+
+	// Take the last chunk, for a thief.
+	bool Steal(std::size_t & begin, std::size_t & end)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (chunks.empty())
+			return false;
+		begin = chunks.back().first;
+		end = chunks.back().second;
+		chunks.pop_back();
+		return true;
+	}
+
+private:
+	typedef std::pair<std::size_t, std::size_t> Chunk;
+
+	std::mutex mutex;
+	std::deque<Chunk> chunks;
+};
+
+/**
+ * WorkStealingFor calls work(worker, begin, end) for chunks [begin, end)
+ * covering [0, count), on up to WorkerCount() threads with work stealing.
+ * worker is the index of the calling thread, in [0, WorkerCount()), so that
+ * each thread can own state such as a GSL stepper.
+ *
+ * std::size_t count : size of the range.
+ * std::size_t chunk : iterations per chunk, at least one.
+ * work : function called as work(unsigned, std::size_t, std::size_t).
+ * return : number of chunks stolen.
+ */
+template <typename Work>
+std::size_t WorkStealingFor(std::size_t count, std::size_t chunk, Work work)
+{
+	chunk = std::max<std::size_t>(1, chunk);
+	std::size_t chunks = (count + chunk - 1) / chunk;
+	unsigned workers = std::max<std::size_t>(1, std::min<std::size_t>(WorkerCount(), chunks));
+
+	// Each thread starts with the chunks of a contiguous shard.
+	std::vector<WorkStealingQueue> queues(workers);
+	for (unsigned id = 0; id != workers; id++)
+		for (std::size_t c = chunks * id / workers; c != chunks * (id + 1) / workers; c++)
+			queues[id].Push(c * chunk, std::min(count, (c + 1) * chunk));
+
+	std::atomic<std::size_t> steals(0);
+
+	auto worker = [&](unsigned id)
+	{
+		std::size_t begin, end;
+
+		while (true)
+		{
+			bool found = queues[id].Pop(begin, end);
+
+			// Look round the other threads in turn, starting with the next.
+			for (unsigned k = 1; !found && k != workers; k++)
+			{
+				if (queues[(id + k) % workers].Steal(begin, end))
+				{
+					found = true;
+					steals++;
+				}
+			}
+
+			// No chunks are added once the queues are filled, so every queue
+			// found empty stays empty and the last chunks are already being
+			// run by other threads.
+			if (!found)
+				return;
+
+			work(id, begin, end);
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for (unsigned id = 1; id < workers; id++)
+		threads.push_back(std::thread(worker, id));
+
+	// The calling thread does its share as worker 0.
+	worker(0);
+
+	for (std::size_t i = 0; i != threads.size(); i++)
+		threads[i].join();
+
+	return steals;
+}
+
+#endif